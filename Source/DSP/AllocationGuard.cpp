@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    AllocationGuard.cpp
+    Replacement global operator new/delete used by the allocation guard.
+
+  ==============================================================================
+*/
+
+#include "AllocationGuard.h"
+
+#if MBC_ALLOCATION_GUARD
+
+#include <cstdlib>
+#include <new>
+
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace {
+    thread_local int guardDepth{ 0 };
+    std::atomic<int> numViolations{ 0 };
+
+    void checkAllocation() noexcept {
+        if (guardDepth == 0)
+            return;
+
+        ++numViolations;
+
+        // the assertion machinery may allocate itself, so step out of the
+        // guard while it runs
+        const auto depth = guardDepth;
+        guardDepth = 0;
+        jassertfalse; // heap traffic inside processBlock
+        guardDepth = depth;
+    }
+
+    void* allocate(std::size_t size) {
+        checkAllocation();
+
+        if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void* allocateAligned(std::size_t size, std::align_val_t alignment) {
+        checkAllocation();
+
+        const auto align = static_cast<std::size_t>(alignment);
+        const auto rounded = ((size == 0 ? 1 : size) + align - 1) / align * align;
+
+       #if JUCE_WINDOWS
+        auto* ptr = _aligned_malloc(rounded, align);
+       #else
+        auto* ptr = std::aligned_alloc(align, rounded);
+       #endif
+
+        if (ptr != nullptr)
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void release(void* ptr) noexcept {
+        if (ptr != nullptr)
+            checkAllocation();
+
+        std::free(ptr);
+    }
+
+    void releaseAligned(void* ptr) noexcept {
+        if (ptr != nullptr)
+            checkAllocation();
+
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        std::free(ptr);
+       #endif
+    }
+}
+
+namespace AllocationGuard {
+    ScopedNoAllocation::ScopedNoAllocation() noexcept { ++guardDepth; }
+    ScopedNoAllocation::~ScopedNoAllocation() noexcept { --guardDepth; }
+
+    int getNumViolations() noexcept { return numViolations.load(); }
+    void resetViolations() noexcept { numViolations = 0; }
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* ptr) noexcept { release(ptr); }
+void operator delete[](void* ptr) noexcept { release(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { release(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { release(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { release(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try { return allocateAligned(size, alignment); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try { return allocateAligned(size, alignment); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { releaseAligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(ptr); }
+
+#endif
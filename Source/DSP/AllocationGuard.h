@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    AllocationGuard.h
+    Debug check that the audio thread stays off the heap.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef MBC_ALLOCATION_GUARD
+ #define MBC_ALLOCATION_GUARD 0
+#endif
+
+/*
+* While a ScopedNoAllocation is alive, any operator new or delete made on the
+* same thread hits a jassert and is counted in getNumViolations(), which the
+* headless tools turn into a failing exit code (see AllocationCheck.h in
+* Tools/Common). It is compiled out unless MBC_ALLOCATION_GUARD is set,
+* which only the debug configurations do.
+*/
+namespace AllocationGuard {
+#if MBC_ALLOCATION_GUARD
+    struct ScopedNoAllocation {
+        ScopedNoAllocation() noexcept;
+        ~ScopedNoAllocation() noexcept;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedNoAllocation)
+    };
+
+    int getNumViolations() noexcept;
+    void resetViolations() noexcept;
+#else
+    struct ScopedNoAllocation {
+        ScopedNoAllocation() noexcept {}
+    };
+
+    inline int getNumViolations() noexcept { return 0; }
+    inline void resetViolations() noexcept {}
+#endif
+}
@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    BandMeter.h
+    Per band levels handed from the audio thread to the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* One writer (the audio thread) and one reader (the editor's timer), and no
+* locks or allocation on either side. Every value is its own relaxed atomic,
+* so a snapshot can mix two neighbouring blocks, which a meter never shows.
+*
+* Peaks and gain reduction hold their maximum until the reader has taken
+* them, so nothing between two frames is missed. The reader bumps readCount
+* after each snapshot; the writer sees that on its next publish() and starts
+* a new maximum instead of needing a read-modify-write loop to reset one.
+*
+* Metering only runs while it is switched on, i.e. while an editor is open.
+*/
+class BandMeter {
+public:
+    struct Level {
+        float peak{ 0.f }, meanSquare{ 0.f };
+    };
+
+    // Linear levels, and the deepest gain reduction in (positive) dB.
+    struct Snapshot {
+        float inputPeak{ 0.f }, inputRms{ 0.f };
+        float outputPeak{ 0.f }, outputRms{ 0.f };
+        float gainReduction{ 0.f };
+    };
+
+    // RMS is averaged over about this long.
+    static constexpr double rmsSeconds = 0.3;
+
+    void setActive(bool shouldBeActive) noexcept { active.store(shouldBeActive, std::memory_order_relaxed); }
+    bool isActive() const noexcept { return active.load(std::memory_order_relaxed); }
+
+    //==============================================================================
+    // audio thread
+
+    void prepare(double sampleRate) {
+        samplesPerTimeConstant = static_cast<float>(sampleRate * rmsSeconds);
+        inputMeanSquare = outputMeanSquare = 0.f;
+    }
+
+    template <typename SampleType>
+    static Level measure(const juce::dsp::AudioBlock<SampleType>& block) noexcept {
+        const auto numSamples = static_cast<int>(block.getNumSamples());
+        const auto numChannels = block.getNumChannels();
+        if (numSamples == 0 || numChannels == 0)
+            return {};
+
+        Level level;
+        auto sum = SampleType(0);
+
+        for (size_t ch = 0; ch < numChannels; ++ch) {
+            const auto* data = block.getChannelPointer(ch);
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax(data, numSamples);
+            level.peak = juce::jmax(level.peak, static_cast<float>(-range.getStart()), static_cast<float>(range.getEnd()));
+
+            for (int i = 0; i < numSamples; ++i)
+                sum += data[i] * data[i];
+        }
+
+        level.meanSquare = static_cast<float>(sum / static_cast<SampleType>(static_cast<size_t>(numSamples) * numChannels));
+        return level;
+    }
+
+    void publish(const Level& input, const Level& output, float gainReductionDb, size_t numSamples) noexcept {
+        const auto count = readCount.load(std::memory_order_relaxed);
+        const auto isNewFrame = count != lastReadCount;
+        lastReadCount = count;
+
+        auto holdMax = [isNewFrame](std::atomic<float>& value, float newValue) {
+            value.store(isNewFrame ? newValue : juce::jmax(newValue, value.load(std::memory_order_relaxed)),
+                        std::memory_order_relaxed);
+        };
+
+        holdMax(inputPeak, input.peak);
+        holdMax(outputPeak, output.peak);
+        holdMax(gainReduction, gainReductionDb);
+
+        // a one pole average of the mean square, advanced by the whole block
+        const auto decay = std::exp(-static_cast<float>(numSamples) / samplesPerTimeConstant);
+        inputMeanSquare = input.meanSquare + decay * (inputMeanSquare - input.meanSquare);
+        outputMeanSquare = output.meanSquare + decay * (outputMeanSquare - output.meanSquare);
+
+        inputRms.store(std::sqrt(inputMeanSquare), std::memory_order_relaxed);
+        outputRms.store(std::sqrt(outputMeanSquare), std::memory_order_relaxed);
+    }
+
+    // The band isn't heard, so it reads as silent.
+    void publishSilence() noexcept {
+        inputMeanSquare = outputMeanSquare = 0.f;
+
+        for (auto* value : { &inputPeak, &inputRms, &outputPeak, &outputRms, &gainReduction })
+            value->store(0.f, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    // editor
+
+    Snapshot read() noexcept {
+        Snapshot snapshot;
+        snapshot.inputPeak = inputPeak.load(std::memory_order_relaxed);
+        snapshot.inputRms = inputRms.load(std::memory_order_relaxed);
+        snapshot.outputPeak = outputPeak.load(std::memory_order_relaxed);
+        snapshot.outputRms = outputRms.load(std::memory_order_relaxed);
+        snapshot.gainReduction = gainReduction.load(std::memory_order_relaxed);
+
+        readCount.fetch_add(1, std::memory_order_relaxed);
+        return snapshot;
+    }
+
+private:
+    std::atomic<float> inputPeak{ 0.f }, inputRms{ 0.f }, outputPeak{ 0.f }, outputRms{ 0.f }, gainReduction{ 0.f };
+    std::atomic<juce::uint32> readCount{ 0 };
+    std::atomic<bool> active{ false };
+
+    // only touched by the writer
+    juce::uint32 lastReadCount{ 0 };
+    float inputMeanSquare{ 0.f }, outputMeanSquare{ 0.f };
+    float samplesPerTimeConstant{ 1.f };
+};
@@ -0,0 +1,180 @@
+/*
+  ==============================================================================
+
+    BandWorkerPool.h
+    Pre-spawned threads that share the per band work of one block.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AllocationGuard.h"
+
+/*
+* run() hands out job indices through a single 64 bit atomic holding the
+* generation, the job count and the next index, so claiming a job is one
+* compare-exchange and a worker that wakes up late can't take a job from a
+* block that has already moved on. The calling (audio) thread claims jobs
+* too, so it never waits on a worker that hasn't woken up yet, only on jobs
+* that are already running. Nothing allocates or locks on the way.
+*
+* Between blocks the workers spin for spinSeconds, which catches back to back
+* blocks in an offline render, and then sleep on their own WaitableEvent. The
+* caller only signals the events when a worker has actually gone to sleep.
+*
+* The workers hold up the audio thread, so they are started as real-time
+* threads with the host block rate as their period, which lets the OS
+* schedule them like the audio thread (on macOS, a time constraint policy).
+* Where the system won't grant that, e.g. Linux without rtprio, they fall
+* back to the highest normal priority.
+*/
+class BandWorkerPool {
+public:
+    using Job = void (*)(void* context, size_t index);
+
+    static constexpr size_t maxJobs = 0xffff;
+    static constexpr double spinSeconds = 100.0e-6;
+
+    // blocksPerSecond is how often run() is called, the host block rate.
+    BandWorkerPool(size_t numWorkers, double blocksPerSecond) : periodHz(blocksPerSecond) {
+        for (size_t i = 0; i < numWorkers; ++i)
+            workers.push_back(std::make_unique<Worker>(*this));
+
+        const auto options = juce::Thread::RealtimeOptions{}.withPeriodHz(periodHz);
+        for (auto& worker : workers)
+            if (!worker->startRealtimeThread(options))
+                worker->startThread(juce::Thread::Priority::highest);
+    }
+
+    ~BandWorkerPool() {
+        for (auto& worker : workers) {
+            worker->signalThreadShouldExit();
+            worker->wake.signal();
+        }
+
+        for (auto& worker : workers)
+            worker->stopThread(1000);
+    }
+
+    size_t getNumWorkers() const noexcept { return workers.size(); }
+    double getPeriodHz() const noexcept { return periodHz; }
+
+    // Calls fn(i) for every i below numJobs, spread over the workers and the
+    // calling thread, and returns once all of them are done.
+    template <typename Fn>
+    void run(size_t numJobs, Fn& fn) noexcept {
+        runJobs(numJobs, [](void* context, size_t index) { (*static_cast<Fn*>(context))(index); }, &fn);
+    }
+
+private:
+    class Worker : public juce::Thread {
+    public:
+        explicit Worker(BandWorkerPool& p) : juce::Thread("Band worker"), pool(p) {}
+
+        void run() override {
+            juce::ScopedNoDenormals noDenormals;
+            juce::uint32 seen{ 0 };
+
+            while (!threadShouldExit()) {
+                const auto generation = pool.waitForWork(*this, seen);
+                if (generation == seen)
+                    continue;
+
+                seen = generation;
+
+                AllocationGuard::ScopedNoAllocation noAllocation;
+                while (pool.claimAndRun(generation)) {}
+            }
+        }
+
+        juce::WaitableEvent wake;
+
+    private:
+        BandWorkerPool& pool;
+    };
+
+    static juce::uint64 pack(juce::uint32 generation, size_t numJobs, size_t next) noexcept {
+        return (static_cast<juce::uint64>(generation) << 32) | (static_cast<juce::uint64>(numJobs) << 16) | next;
+    }
+
+    juce::uint32 currentGeneration() const noexcept {
+        return static_cast<juce::uint32>(state.load(std::memory_order_acquire) >> 32);
+    }
+
+    void runJobs(size_t numJobs, Job job, void* context) noexcept {
+        jassert(numJobs <= maxJobs);
+
+        currentJob = job;
+        currentContext = context;
+        numDone.store(0, std::memory_order_relaxed);
+
+        const auto generation = ++lastGeneration;
+        state.store(pack(generation, numJobs, 0));
+
+        if (numSleeping.load() > 0)
+            for (auto& worker : workers)
+                worker->wake.signal();
+
+        while (claimAndRun(generation)) {}
+
+        while (numDone.load(std::memory_order_acquire) < numJobs)
+            std::this_thread::yield();
+    }
+
+    // Runs the next job of this generation. False once they are all taken,
+    // or the generation has moved on.
+    bool claimAndRun(juce::uint32 generation) noexcept {
+        auto current = state.load(std::memory_order_acquire);
+
+        for (;;) {
+            const auto numJobs = (current >> 16) & maxJobs;
+            const auto next = current & maxJobs;
+
+            if (static_cast<juce::uint32>(current >> 32) != generation || next >= numJobs)
+                return false;
+
+            if (state.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                currentJob(currentContext, static_cast<size_t>(next));
+                numDone.fetch_add(1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    // Spins for a while, then sleeps until the generation moves past 'seen'
+    // or the worker is told to exit. Whichever of the sleeper and run() gets
+    // to its second check last sees the other one's store.
+    juce::uint32 waitForWork(Worker& worker, juce::uint32 seen) {
+        const auto spinUntil = juce::Time::getHighResolutionTicks()
+                             + juce::Time::secondsToHighResolutionTicks(spinSeconds);
+
+        while (juce::Time::getHighResolutionTicks() < spinUntil) {
+            if (const auto generation = currentGeneration(); generation != seen)
+                return generation;
+
+            std::this_thread::yield();
+        }
+
+        ++numSleeping;
+
+        if (currentGeneration() == seen && !worker.threadShouldExit())
+            worker.wake.wait(-1);
+
+        --numSleeping;
+        return currentGeneration();
+    }
+
+    const double periodHz;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<juce::uint64> state{ 0 };
+    std::atomic<size_t> numDone{ 0 };
+    std::atomic<int> numSleeping{ 0 };
+
+    // written by run() before the generation is published
+    Job currentJob{ nullptr };
+    void* currentContext{ nullptr };
+    juce::uint32 lastGeneration{ 0 };
+};
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    ChannelGroups.h
+    Which channels of a layout share a detector in grouped link mode.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* Grouped linking holds the image of each part of a layout still without
+* letting one part pump another: the front channels (left, right, centre
+* and the wides) share a detector, as do the surrounds, the height layer and
+* the bottom layer. An ambisonic field only makes sense whole, so all of its
+* channels share one. Each LFE and any discrete channel is on its own.
+*
+* Mono and stereo come out as a single group, so grouped and linked sound
+* the same there.
+*/
+namespace ChannelGroups {
+    // One group index per channel of the layout, numbered in the order the
+    // groups first appear.
+    inline std::vector<size_t> forLayout(const juce::AudioChannelSet& layout) {
+        using Set = juce::AudioChannelSet;
+
+        enum Kind { front, surround, height, bottom, ambisonic, alone };
+
+        auto kindOf = [](Set::ChannelType type) {
+            switch (type) {
+                case Set::left: case Set::right: case Set::centre:
+                case Set::leftCentre: case Set::rightCentre:
+                case Set::wideLeft: case Set::wideRight:
+                    return front;
+
+                case Set::leftSurround: case Set::rightSurround: case Set::centreSurround:
+                case Set::leftSurroundSide: case Set::rightSurroundSide:
+                case Set::leftSurroundRear: case Set::rightSurroundRear:
+                    return surround;
+
+                case Set::topMiddle: case Set::topFrontLeft: case Set::topFrontCentre: case Set::topFrontRight:
+                case Set::topRearLeft: case Set::topRearCentre: case Set::topRearRight:
+                case Set::topSideLeft: case Set::topSideRight:
+                    return height;
+
+                case Set::bottomFrontLeft: case Set::bottomFrontCentre: case Set::bottomFrontRight:
+                case Set::bottomSideLeft: case Set::bottomSideRight:
+                case Set::bottomRearLeft: case Set::bottomRearCentre: case Set::bottomRearRight:
+                    return bottom;
+
+                default:
+                    return type >= Set::ambisonicACN0 && type <= Set::ambisonicACN63 ? ambisonic : alone;
+            }
+        };
+
+        const auto numChannels = static_cast<size_t>(layout.size());
+        std::vector<size_t> groups(numChannels);
+        std::array<size_t, alone> groupOfKind;
+        groupOfKind.fill(numChannels);
+        size_t numGroups{ 0 };
+
+        for (size_t ch{ 0 }; ch < numChannels; ++ch) {
+            const auto kind = kindOf(layout.getTypeOfChannel(static_cast<int>(ch)));
+
+            if (kind == alone) {
+                groups[ch] = numGroups++;
+                continue;
+            }
+
+            if (groupOfKind[kind] == numChannels)
+                groupOfKind[kind] = numGroups++;
+
+            groups[ch] = groupOfKind[kind];
+        }
+
+        return groups;
+    }
+}
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    CoefficientCache.h
+    Crossover coefficients shared by every instance in the process.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* A session full of instances mostly runs the same crossovers at the same
+* sample rate, so the coefficients of a split are worked out once per
+* process and looked up after that. Hold one through a
+* juce::SharedResourcePointer; the cache lives as long as any instance does.
+*
+* All three TPT sections of a Linkwitz-Riley split (lowpass, highpass and
+* allpass) run on the same coefficients, so an entry is keyed by the sample
+* rate and the frequency alone.
+*
+* The table is a fixed array of slots with open addressing. A slot is
+* claimed with a compare-exchange, filled in and then published; after that
+* it never changes, so lookups are a handful of atomic loads and never wait
+* or allocate. Entries are added by get(), which is meant for prepare() and
+* the message thread. Nothing is ever evicted, so only frequencies that have
+* stayed put are added: a knob drag or an automation lane passes through
+* hundreds that would otherwise fill the table for every instance. The
+* audio thread only calls find() and works the coefficients out itself when
+* it misses, e.g. in the middle of a ramp. A full table stops caching, and
+* still answers every call.
+*/
+class CoefficientCache {
+public:
+    struct Coefficients {
+        double g{ 0 }, h{ 0 }, r2PlusG{ 0 };
+    };
+
+    static constexpr size_t capacity = 1024;
+    static constexpr size_t maxProbes = 16;
+
+    static Coefficients compute(double sampleRate, double frequency) noexcept {
+        const auto g = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+        const auto r2 = std::sqrt(2.0);
+        return { g, 1.0 / (1.0 + r2 * g + g * g), r2 + g };
+    }
+
+    // Any thread, the audio thread included.
+    bool find(double sampleRate, double frequency, Coefficients& result) const noexcept {
+        const auto start = hash(sampleRate, frequency);
+
+        for (size_t probe = 0; probe < maxProbes; ++probe) {
+            const auto& slot = slots[(start + probe) % capacity];
+            const auto state = slot.state.load(std::memory_order_acquire);
+
+            if (state == empty)
+                return false;
+
+            if (state == published && slot.sampleRate == sampleRate && slot.frequency == frequency) {
+                result = slot.coefficients;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Off the audio thread: looks the coefficients up, or works them out
+    // and adds them for everyone else.
+    Coefficients get(double sampleRate, double frequency) noexcept {
+        Coefficients result;
+        if (find(sampleRate, frequency, result))
+            return result;
+
+        result = compute(sampleRate, frequency);
+        const auto start = hash(sampleRate, frequency);
+
+        for (size_t probe = 0; probe < maxProbes; ++probe) {
+            auto& slot = slots[(start + probe) % capacity];
+            auto state = slot.state.load(std::memory_order_acquire);
+
+            // someone else got there first
+            if (state == published && slot.sampleRate == sampleRate && slot.frequency == frequency)
+                break;
+
+            if (state != empty || !slot.state.compare_exchange_strong(state, claimed, std::memory_order_acquire))
+                continue;
+
+            slot.sampleRate = sampleRate;
+            slot.frequency = frequency;
+            slot.coefficients = result;
+            slot.state.store(published, std::memory_order_release);
+            break;
+        }
+
+        return result;
+    }
+
+private:
+    enum State : int { empty, claimed, published };
+
+    struct Slot {
+        std::atomic<int> state{ empty };
+        double sampleRate{ 0 }, frequency{ 0 };
+        Coefficients coefficients;
+    };
+
+    static size_t hash(double sampleRate, double frequency) noexcept {
+        juce::uint64 rate, hz;
+        std::memcpy(&rate, &sampleRate, sizeof(rate));
+        std::memcpy(&hz, &frequency, sizeof(hz));
+
+        // the low bits of round numbers are all zero, so everything is
+        // mixed down into them (MurmurHash3's finaliser)
+        auto h = rate ^ (hz + 0x9e3779b97f4a7c15ull + (rate << 6) + (rate >> 2));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h % capacity);
+    }
+
+    std::array<Slot, capacity> slots;
+};
@@ -0,0 +1,600 @@
+/*
+  ==============================================================================
+
+    CompressorBand.h
+    One band's compressor and its smoothed settings.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Params.h"
+#include "BandMeter.h"
+#include "CompressorKernel.h"
+#include "LookaheadDelay.h"
+
+// SampleType is float or double; the settings stay float either way.
+template <typename SampleType>
+struct CompressorBand {
+    // Raw parameter values, looked up once in Attach(). Reading them on the
+    // audio thread is a plain atomic load.
+    std::atomic<float>* Attack{ nullptr };
+    std::atomic<float>* Release{ nullptr };
+    std::atomic<float>* Threshold{ nullptr };
+    std::atomic<float>* SideThreshold{ nullptr };
+    std::atomic<float>* Ratio{ nullptr };
+    std::atomic<float>* Knee{ nullptr };
+    std::atomic<float>* Link{ nullptr };
+    std::atomic<float>* Lookahead{ nullptr };
+    std::atomic<float>* ExternalKey{ nullptr };
+    std::atomic<float>* Bypassed{ nullptr };
+    std::atomic<float>* Mute{ nullptr };
+    std::atomic<float>* Solo{ nullptr };
+
+    // Levels for the editor, measured in Process() while it is active.
+    BandMeter Meter;
+
+    void Attach(juce::AudioProcessorValueTreeState& apvts, size_t band, size_t numBands) {
+        auto rawHelper = [&apvts, band, numBands](auto& Param, Params::Names ParamName) {
+            Param = apvts.getRawParameterValue(Params::BandParamID(ParamName, band, numBands));
+            jassert(Param);
+        };
+
+        rawHelper(Attack, Params::Attack);
+        rawHelper(Release, Params::Release);
+        rawHelper(Threshold, Params::Threshold);
+        rawHelper(SideThreshold, Params::SideThreshold);
+        rawHelper(Ratio, Params::Ratio);
+        rawHelper(Knee, Params::Knee);
+        rawHelper(Link, Params::Link);
+        rawHelper(Lookahead, Params::Lookahead);
+        rawHelper(ExternalKey, Params::ExternalKey);
+        rawHelper(Bypassed, Params::Bypassed);
+        rawHelper(Mute, Params::Mute);
+        rawHelper(Solo, Params::Solo);
+    }
+
+    bool IsBypassed() const noexcept { return Bypassed->load() > 0.5f; }
+    bool IsMuted() const noexcept { return Mute->load() > 0.5f; }
+    bool IsSoloed() const noexcept { return Solo->load() > 0.5f; }
+    bool IsKeyedExternally() const noexcept { return ExternalKey->load() > 0.5f; }
+
+    // Params::LinkChoices is in the order of the kernel's modes.
+    using LinkMode = typename CompressorKernel<SampleType>::LinkMode;
+
+    LinkMode GetLinkMode() const noexcept {
+        const auto index = juce::jlimit(0, static_cast<int>(Params::LinkChoices.size()) - 1, static_cast<int>(Link->load()));
+        return static_cast<LinkMode>(index);
+    }
+
+    // The Lookahead parameter in samples at the given rate.
+    size_t GetLookaheadSamples(double sampleRate) const noexcept {
+        return LookaheadSamples(Lookahead->load(), sampleRate);
+    }
+
+    static size_t LookaheadSamples(float milliseconds, double sampleRate) noexcept {
+        return static_cast<size_t>(juce::roundToInt(milliseconds * sampleRate / 1000.0));
+    }
+
+    // Settings glide to new values over parameterRampSeconds, updated every
+    // parameterUpdateInterval samples, so automation doesn't zipper.
+    static constexpr double parameterRampSeconds = 0.05;
+    static constexpr size_t parameterUpdateInterval = 32;
+
+    // Bypass fades between the compressed and the dry band over this long.
+    static constexpr double bypassFadeSeconds = 0.01;
+
+    // With an oversamplingOrder above 0 the compressor runs at 2^order times
+    // the sample rate, between the half-band filters of a juce Oversampling.
+    // A band prepared with shouldOversample off compresses at the host rate
+    // and only takes on the filters' delay, in its lookahead line, so it
+    // still lines up with the bands that are oversampled.
+    //
+    // The band delays its audio by the longest lookahead of all the bands
+    // and its detector by the difference to its own (see SetLookahead()), so
+    // every band lines up whatever its own lookahead is. The delay line lives
+    // in storage handed over afterwards with SetLookaheadStorage(),
+    // GetLookaheadStorageSize() samples of it, sized for up to maxLookahead
+    // samples so the lookahead can change without preparing again. An
+    // external key is delayed like the detector, in a line of its own from
+    // the same storage, plus the up filters' delay when oversampled: the
+    // detector hears the band after them, the key is only held.
+    //
+    // Everything is allocated here, nothing on the audio thread. The channel
+    // groups for grouped linking are set before, with SetChannelGroups().
+    void Prepare(juce::dsp::ProcessSpec& spec, size_t oversamplingOrder = 0, size_t maxLookahead = 0,
+                 bool shouldOversample = true) {
+        oversampler.reset();
+        oversamplingLatency = alignmentDelay = keyLatency = 0;
+
+        if (oversamplingOrder > 0) {
+            // linear phase with an integer delay, so a band that skips the
+            // oversampler can be held back by the same whole number of
+            // samples and still line up with the others
+            oversampler = std::make_unique<juce::dsp::Oversampling<SampleType>>(spec.numChannels, oversamplingOrder,
+                juce::dsp::Oversampling<SampleType>::filterHalfBandFIREquiripple, false, true);
+            oversamplingLatency = static_cast<size_t>(juce::roundToInt(oversampler->getLatencyInSamples()));
+
+            if (!shouldOversample) {
+                alignmentDelay = oversamplingLatency;
+                oversampler.reset();
+                oversamplingOrder = 0;
+            }
+        }
+
+        oversamplingFactor = size_t(1) << oversamplingOrder;
+        detectorDelay = audioDelay = alignmentDelay;
+        maxDelay = maxLookahead * oversamplingFactor + alignmentDelay;
+        lookaheadBlockSize = spec.maximumBlockSize * oversamplingFactor;
+        delayLine.setStorage(nullptr, 0, 0, 0);
+        keyDelayLine.setStorage(nullptr, 0, 0, 0);
+        keyBuffer.setSize(static_cast<int>(spec.numChannels), static_cast<int>(lookaheadBlockSize));
+
+        if (oversampler != nullptr) {
+            oversampler->initProcessing(spec.maximumBlockSize);
+            keyLatency = measureUpsamplingLatency(spec.maximumBlockSize);
+        }
+
+        lookaheadChannels.assign(maxDelay + keyLatency > 0 ? spec.numChannels : 0, nullptr);
+
+        latency = oversamplingLatency;
+
+        auto oversampledSpec = spec;
+        oversampledSpec.sampleRate *= static_cast<double>(oversamplingFactor);
+        oversampledSpec.maximumBlockSize *= static_cast<juce::uint32>(oversamplingFactor);
+        compressor.prepare(oversampledSpec);
+
+        dryBuffer.setSize(static_cast<int>(spec.numChannels), static_cast<int>(spec.maximumBlockSize + oversamplingLatency + maxLookahead));
+        dryBuffer.clear();
+        historyIsStale = false;
+
+        Meter.prepare(spec.sampleRate);
+
+        // start out at the current settings rather than gliding to them
+        UpdateCompressorSettings();
+        attack.reset(spec.sampleRate, parameterRampSeconds);
+        release.reset(spec.sampleRate, parameterRampSeconds);
+        threshold.reset(spec.sampleRate, parameterRampSeconds);
+        sideThreshold.reset(spec.sampleRate, parameterRampSeconds);
+        ratioValue.reset(spec.sampleRate, parameterRampSeconds);
+        knee.reset(spec.sampleRate, parameterRampSeconds);
+        wetMix.reset(spec.sampleRate, bypassFadeSeconds);
+
+        applySettings(attack.getTargetValue(), release.getTargetValue(), threshold.getTargetValue(),
+                      sideThreshold.getTargetValue(), ratioValue.getTargetValue(), knee.getTargetValue());
+        isSuspended = false;
+        wasKeyed = false;
+        delayIsStale = true;
+    }
+
+    // Audio thread: the band's own lookahead and the longest of all the
+    // bands', in samples at the host rate and no more than the maxLookahead
+    // given to Prepare(). A change only moves the taps of the delay lines;
+    // the dry history no longer lines up with the new latency, so it starts
+    // again from silence.
+    void SetLookahead(size_t lookahead, size_t maxLookahead) noexcept {
+        jassert(lookahead <= maxLookahead && maxLookahead * oversamplingFactor + alignmentDelay <= maxDelay);
+        const auto newAudioDelay = maxLookahead * oversamplingFactor + alignmentDelay;
+        const auto newDetectorDelay = (maxLookahead - lookahead) * oversamplingFactor + alignmentDelay;
+
+        if (newAudioDelay == audioDelay && newDetectorDelay == detectorDelay)
+            return;
+
+        // the lines aren't written while nothing is delayed, so they hold
+        // whatever was there when they last were
+        delayIsStale = delayIsStale || audioDelay == 0;
+        audioDelay = newAudioDelay;
+        detectorDelay = newDetectorDelay;
+
+        if (oversamplingLatency + maxLookahead != latency) {
+            latency = oversamplingLatency + maxLookahead;
+            historyIsStale = true;
+        }
+    }
+
+    // A group index per channel (see ChannelGroups), taken up by Prepare().
+    void SetChannelGroups(const std::vector<size_t>& groups) { compressor.setChannelGroups(groups); }
+
+    // The band arrives as mid and side rather than left and right: each gets
+    // a detector of its own and the side compresses against Side Threshold.
+    // Set before Prepare().
+    void SetMidSide(bool shouldBeMidSide) noexcept { compressor.setMidSide(shouldBeMidSide); }
+
+    // Only hands the new targets to the smoothers. A parameter that hasn't
+    // changed leaves its smoother idle and costs nothing in Process().
+    void UpdateCompressorSettings() {
+        attack.setTargetValue(Attack->load());
+        release.setTargetValue(Release->load());
+        threshold.setTargetValue(Threshold->load());
+        sideThreshold.setTargetValue(SideThreshold->load());
+        ratioValue.setTargetValue(Params::RatioFromIndex(Ratio->load()));
+        knee.setTargetValue(Knee->load());
+        compressor.setLinkMode(GetLinkMode());
+        wetMix.setTargetValue(IsBypassed() ? 0.f : 1.f);
+    }
+
+    // Bypassed and done fading out, so Process() won't touch the audio.
+    bool IsFullyBypassed() const noexcept {
+        return !wetMix.isSmoothing() && wetMix.getTargetValue() == 0.f;
+    }
+
+    // Samples of the shared arena this band's delay lines need: the line
+    // itself, room for the detector's copy of one block, then the key's line.
+    size_t GetLookaheadStorageSize() const noexcept {
+        const auto numChannels = lookaheadChannels.size();
+        return LookaheadDelay<SampleType>::getStorageSize(numChannels, maxDelay, lookaheadBlockSize)
+             + numChannels * lookaheadBlockSize
+             + LookaheadDelay<SampleType>::getStorageSize(numChannels, maxDelay + keyLatency, lookaheadBlockSize);
+    }
+
+    // Called after Prepare(), with storage that stays put until the next one.
+    void SetLookaheadStorage(SampleType* storage) {
+        const auto numChannels = lookaheadChannels.size();
+        if (numChannels == 0)
+            return;
+
+        delayLine.setStorage(storage, numChannels, maxDelay, lookaheadBlockSize);
+
+        auto* detector = storage + LookaheadDelay<SampleType>::getStorageSize(numChannels, maxDelay, lookaheadBlockSize);
+        for (size_t ch{ 0 }; ch < numChannels; ++ch)
+            lookaheadChannels[ch] = detector + ch * lookaheadBlockSize;
+
+        keyDelayLine.setStorage(detector + numChannels * lookaheadBlockSize, numChannels, maxDelay + keyLatency, lookaheadBlockSize);
+    }
+
+    // The delay the oversampling filters add, in samples at the host rate.
+    // Every band has it, oversampled or not, and it only changes in Prepare();
+    // the lookahead comes on top.
+    size_t GetOversamplingLatency() const noexcept { return oversamplingLatency; }
+
+    // With a key block, its matching band of the sidechain, and External Key
+    // on, the detector listens to the key instead of the band. Key channels
+    // key the band's channels of the same index; a key with fewer channels
+    // than the band keys the rest (C, LFE, the surrounds and heights under a
+    // stereo key) from the mean of all of its channels, and a mono band
+    // takes that mean too. A mono key so drives every channel. In mid/side a
+    // stereo key is encoded like the band, so the side detector follows the
+    // key's side.
+    void Process(const juce::dsp::AudioBlock<SampleType>& bandBlock,
+                 const juce::dsp::AudioBlock<const SampleType>* keyBlock = nullptr) {
+        const auto* key = keyBlock != nullptr && keyBlock->getNumChannels() > 0 && IsKeyedExternally() ? keyBlock : nullptr;
+        const auto isMetering = Meter.isActive();
+
+        compressor.setMetering(isMetering);
+        process(bandBlock, key);
+
+        if (!isMetering)
+            return;
+
+        // the compressor measures as it applies its gain; a bypassed band
+        // skipped it and comes out as it went in, so one look at it does
+        const auto levels = compressor.takeLevels();
+        if (levels.numValues == 0) {
+            const auto level = BandMeter::measure(bandBlock);
+            Meter.publish(level, level, GetGainReductionDb(), bandBlock.getNumSamples());
+            return;
+        }
+
+        const auto count = static_cast<double>(levels.numValues);
+        const BandMeter::Level input{ levels.inputPeak, static_cast<float>(levels.inputSquares / count) };
+        const BandMeter::Level output{ levels.outputPeak, static_cast<float>(levels.outputSquares / count) };
+        Meter.publish(input, output, GetGainReductionDb(), bandBlock.getNumSamples());
+    }
+
+    // At the end of the last block, in positive dB; none while suspended.
+    float GetGainReductionDb() const noexcept {
+        return isSuspended ? 0.f : -compressor.getGainDb();
+    }
+
+    // Called instead of Process() while the band can't be heard. The envelope
+    // goes stale, so it is cleared when the band comes back; it starts again
+    // from no gain reduction, which is what the band sounded like while it was
+    // off. So does the dry history, which fades back in from silence.
+    void Suspend() {
+        suspendCompressor();
+        historyIsStale = latency > 0;
+
+        if (Meter.isActive())
+            Meter.publishSilence();
+    }
+private:
+    void process(const juce::dsp::AudioBlock<SampleType>& bandBlock, const juce::dsp::AudioBlock<const SampleType>* key) {
+        if (historyIsStale) {
+            dryBuffer.clear();
+            historyIsStale = false;
+        }
+
+        // a bypassed band only needs lining up with the others, so it skips
+        // the oversampler as well as the compressor
+        if (IsFullyBypassed()) {
+            if (latency > 0) {
+                bandBlock.copyFrom(pushDry(bandBlock));
+                popDry(bandBlock.getNumSamples());
+            }
+
+            suspendCompressor();
+            return;
+        }
+
+        if (isSuspended)
+            resume();
+
+        if (latency == 0 && !wetMix.isSmoothing()) {
+            compress(bandBlock, key);
+            return;
+        }
+
+        // fading in or out of bypass, or keeping the dry history going for
+        // when that happens: compress, then mix with the delayed dry copy
+        const auto dry = pushDry(bandBlock);
+
+        compress(bandBlock, key);
+
+        if (wetMix.isSmoothing()) {
+            const auto numChannels = bandBlock.getNumChannels();
+            for (size_t i{ 0 }; i < bandBlock.getNumSamples(); ++i) {
+                const auto mix = wetMix.getNextValue();
+                for (size_t ch{ 0 }; ch < numChannels; ++ch) {
+                    const auto d = dry.getChannelPointer(ch)[i];
+                    auto& wet = bandBlock.getChannelPointer(ch)[i];
+                    wet = d + (wet - d) * mix;
+                }
+            }
+        }
+
+        popDry(bandBlock.getNumSamples());
+    }
+
+    void suspendCompressor() {
+        isSuspended = true;
+        wetMix.setCurrentAndTargetValue(wetMix.getTargetValue());
+    }
+
+    // Parameters glide in steps of parameterUpdateInterval host rate samples,
+    // however far the block is oversampled.
+    //
+    // With lookahead the detector gets a copy of the block delayed by
+    // detectorDelay and the block itself is swapped for its audioDelay copy,
+    // so the gain moves before the transient it reacts to arrives.
+    void compress(const juce::dsp::AudioBlock<SampleType>& bandBlock, const juce::dsp::AudioBlock<const SampleType>* key) {
+        const auto numSamples = bandBlock.getNumSamples();
+        const auto block = oversampler != nullptr ? oversampler->processSamplesUp(bandBlock) : bandBlock;
+        auto detector = block;
+
+        if (audioDelay > 0) {
+            // the key's line keeps running on the up filters' delay alone
+            if (delayIsStale) {
+                delayLine.reset();
+                if (keyLatency == 0)
+                    keyDelayLine.reset();
+                delayIsStale = false;
+            }
+
+            detector = juce::dsp::AudioBlock<SampleType>(lookaheadChannels.data(), block.getNumChannels(), block.getNumSamples());
+
+            delayLine.push(block);
+            delayLine.read(detectorDelay, detector);
+            delayLine.read(audioDelay, block);
+        }
+
+        // the key's delay line only runs while the key is heard, and starts
+        // from silence when it is switched to
+        if (key != nullptr) {
+            if (!wasKeyed)
+                keyDelayLine.reset();
+
+            detector = prepareKey(*key, block.getNumChannels(), block.getNumSamples());
+        }
+
+        wasKeyed = key != nullptr;
+
+        for (size_t start{ 0 }; start < numSamples;) {
+            auto length = numSamples - start;
+
+            if (isSmoothing()) {
+                length = juce::jmin(length, parameterUpdateInterval);
+                updateSmoothedSettings(static_cast<int>(length));
+            }
+
+            const auto offset = start * oversamplingFactor;
+            const auto count = length * oversamplingFactor;
+            compressor.process(detector.getSubBlock(offset, count), block.getSubBlock(offset, count));
+
+            start += length;
+        }
+
+        if (oversampler != nullptr) {
+            auto output = bandBlock;
+            oversampler->processSamplesDown(output);
+        }
+    }
+
+    // The key at the compressor's rate, one channel per band channel, held
+    // for the oversampled samples rather than run through the oversampler:
+    // the detector only needs its level. It goes through the key's delay
+    // line for the lookahead and the up filters' delay, so it lines up with
+    // the detector it replaces.
+    juce::dsp::AudioBlock<SampleType> prepareKey(const juce::dsp::AudioBlock<const SampleType>& key,
+                                                 size_t numChannels, size_t numSamples) {
+        auto dest = juce::dsp::AudioBlock<SampleType>(keyBuffer).getSubsetChannelBlock(0, numChannels).getSubBlock(0, numSamples);
+
+        // the crossover is linear, so encoding the key's band is the same as
+        // splitting an encoded key; done in the copy rather than a pass of
+        // its own
+        if (compressor.isMidSide() && key.getNumChannels() >= 2 && numChannels == 2) {
+            const auto* left = key.getChannelPointer(0);
+            const auto* right = key.getChannelPointer(1);
+            auto* mid = dest.getChannelPointer(0);
+            auto* side = dest.getChannelPointer(1);
+            const auto half = static_cast<SampleType>(0.5);
+
+            for (size_t i{ 0 }; i < numSamples; ++i) {
+                const auto j = i / oversamplingFactor;
+                mid[i] = (left[j] + right[j]) * half;
+                side[i] = (left[j] - right[j]) * half;
+            }
+
+            return delayKey(dest);
+        }
+
+        const auto numKeyChannels = key.getNumChannels();
+        const auto numMapped = numChannels > 1 ? juce::jmin(numChannels, numKeyChannels) : size_t(0);
+
+        for (size_t ch{ 0 }; ch < numMapped; ++ch) {
+            const auto* source = key.getChannelPointer(ch);
+            auto* data = dest.getChannelPointer(ch);
+
+            if (oversamplingFactor == 1) {
+                std::copy_n(source, numSamples, data);
+                continue;
+            }
+
+            for (size_t i{ 0 }; i < numSamples; ++i)
+                data[i] = source[i / oversamplingFactor];
+        }
+
+        if (numMapped == numChannels)
+            return delayKey(dest);
+
+        // the mean is worked out into the first channel left over and copied
+        // to the others
+        auto* mean = dest.getChannelPointer(numMapped);
+        const auto scale = SampleType(1) / static_cast<SampleType>(numKeyChannels);
+
+        for (size_t i{ 0 }; i < numSamples; ++i) {
+            const auto j = i / oversamplingFactor;
+            auto sum = key.getChannelPointer(0)[j];
+            for (size_t ch{ 1 }; ch < numKeyChannels; ++ch)
+                sum += key.getChannelPointer(ch)[j];
+
+            mean[i] = sum * scale;
+        }
+
+        for (size_t ch{ numMapped + 1 }; ch < numChannels; ++ch)
+            std::copy_n(mean, numSamples, dest.getChannelPointer(ch));
+
+        return delayKey(dest);
+    }
+
+    juce::dsp::AudioBlock<SampleType> delayKey(const juce::dsp::AudioBlock<SampleType>& dest) {
+        if (audioDelay > 0 || keyLatency > 0) {
+            keyDelayLine.push(dest);
+            keyDelayLine.read(detectorDelay + keyLatency, dest);
+        }
+
+        return dest;
+    }
+
+    // Where an impulse comes out of processSamplesUp(), in oversampled
+    // samples. Oversampling only reports the round trip, and its up and down
+    // filters differ. Message thread, before the oversampler is used.
+    size_t measureUpsamplingLatency(size_t blockSize) {
+        juce::AudioBuffer<SampleType> impulse(1, static_cast<int>(blockSize));
+        const auto numBlocks = oversamplingLatency / blockSize + 2;
+        SampleType peak{ 0 };
+        size_t peakPosition{ 0 };
+
+        for (size_t b{ 0 }; b < numBlocks; ++b) {
+            impulse.clear();
+            if (b == 0)
+                impulse.setSample(0, 0, SampleType(1));
+
+            const auto up = oversampler->processSamplesUp(juce::dsp::AudioBlock<SampleType>(impulse));
+            for (size_t i{ 0 }; i < up.getNumSamples(); ++i) {
+                const auto value = std::abs(up.getChannelPointer(0)[i]);
+                if (value > peak) {
+                    peak = value;
+                    peakPosition = b * up.getNumSamples() + i;
+                }
+            }
+        }
+
+        oversampler->reset();
+        return peakPosition;
+    }
+
+    // dryBuffer holds the last 'latency' input samples followed by the block,
+    // so its first numSamples are the block delayed by the latency. With no
+    // latency that is a plain copy.
+    juce::dsp::AudioBlock<SampleType> pushDry(const juce::dsp::AudioBlock<SampleType>& bandBlock) {
+        const auto numSamples = bandBlock.getNumSamples();
+        auto dry = juce::dsp::AudioBlock<SampleType>(dryBuffer).getSubsetChannelBlock(0, bandBlock.getNumChannels());
+        dry.getSubBlock(latency, numSamples).copyFrom(bandBlock);
+        return dry.getSubBlock(0, numSamples);
+    }
+
+    // Keeps the end of the block as the history for the next one.
+    void popDry(size_t numSamples) {
+        if (latency == 0)
+            return;
+
+        for (int ch{ 0 }; ch < dryBuffer.getNumChannels(); ++ch) {
+            auto* data = dryBuffer.getWritePointer(ch);
+            std::memmove(data, data + numSamples, latency * sizeof(SampleType));
+        }
+    }
+
+    // Settings that moved while suspended are jumped to, not glided to.
+    void resume() {
+        compressor.reset();
+        if (oversampler != nullptr)
+            oversampler->reset();
+        delayLine.reset();
+        wasKeyed = false;
+
+        attack.setCurrentAndTargetValue(attack.getTargetValue());
+        release.setCurrentAndTargetValue(release.getTargetValue());
+        threshold.setCurrentAndTargetValue(threshold.getTargetValue());
+        sideThreshold.setCurrentAndTargetValue(sideThreshold.getTargetValue());
+        ratioValue.setCurrentAndTargetValue(ratioValue.getTargetValue());
+        knee.setCurrentAndTargetValue(knee.getTargetValue());
+        applySettings(attack.getTargetValue(), release.getTargetValue(), threshold.getTargetValue(),
+                      sideThreshold.getTargetValue(), ratioValue.getTargetValue(), knee.getTargetValue());
+
+        isSuspended = false;
+    }
+
+    bool isSmoothing() const noexcept {
+        return attack.isSmoothing() || release.isSmoothing()
+            || threshold.isSmoothing() || sideThreshold.isSmoothing() || ratioValue.isSmoothing() || knee.isSmoothing();
+    }
+
+    void updateSmoothedSettings(int numSamples) {
+        if (attack.isSmoothing())
+            compressor.setAttack(attack.skip(numSamples));
+        if (release.isSmoothing())
+            compressor.setRelease(release.skip(numSamples));
+        if (threshold.isSmoothing())
+            compressor.setThreshold(threshold.skip(numSamples));
+        if (sideThreshold.isSmoothing())
+            compressor.setSideThreshold(sideThreshold.skip(numSamples));
+        if (ratioValue.isSmoothing())
+            compressor.setRatio(ratioValue.skip(numSamples));
+        if (knee.isSmoothing())
+            compressor.setKnee(knee.skip(numSamples));
+    }
+
+    void applySettings(float attackMs, float releaseMs, float thresholdDb, float sideThresholdDb, float ratioToOne, float kneeDb) {
+        compressor.setAttack(attackMs);
+        compressor.setRelease(releaseMs);
+        compressor.setThreshold(thresholdDb);
+        compressor.setSideThreshold(sideThresholdDb);
+        compressor.setRatio(ratioToOne);
+        compressor.setKnee(kneeDb);
+    }
+
+    CompressorKernel<SampleType> compressor;
+    juce::SmoothedValue<float> attack, release, threshold, sideThreshold, knee;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> ratioValue{ 1.f };
+    juce::SmoothedValue<float> wetMix{ 1.f };
+    juce::AudioBuffer<SampleType> dryBuffer;
+    std::unique_ptr<juce::dsp::Oversampling<SampleType>> oversampler;
+    size_t oversamplingFactor{ 1 }, oversamplingLatency{ 0 }, latency{ 0 };
+    LookaheadDelay<SampleType> delayLine, keyDelayLine;
+    juce::AudioBuffer<SampleType> keyBuffer;
+    std::vector<SampleType*> lookaheadChannels;
+    size_t detectorDelay{ 0 }, audioDelay{ 0 }, maxDelay{ 0 }, keyLatency{ 0 }, alignmentDelay{ 0 }, lookaheadBlockSize{ 0 };
+    bool isSuspended{ false }, historyIsStale{ false }, wasKeyed{ false }, delayIsStale{ true };
+};
@@ -0,0 +1,325 @@
+/*
+  ==============================================================================
+
+    CompressorKernel.h
+    Feed-forward compressor with a block based log domain gain computer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FastMath.h"
+
+/*
+* Stands in for juce::dsp::Compressor, which runs a ballistics filter on every
+* channel's level and then calls Decibels and std::pow for every sample. Here
+* the block goes through in four passes:
+*
+*   1. the detector takes |x| of every channel with FloatVectorOperations and,
+*      when the channels are linked, keeps the maximum across them
+*   2. FastMath::log2 turns the level into dB and the static curve (threshold,
+*      ratio and a quadratic soft knee) turns that into a gain in dB
+*   3. attack and release smooth that gain, one sample after the other
+*   4. FastMath::exp2 takes the gain back to linear and it is multiplied in
+*
+* Passes 1, 2 and 4 have no branches and no state, so they vectorise; only the
+* one-pole smoothing in pass 3 is serial. Attack and release use the time
+* constants of juce::dsp::BallisticsFilter, and the smoothing happens on the
+* gain in dB, so release sounds the same however deep the gain reduction.
+*
+* Independent, every channel has its own detector like juce::dsp::Compressor.
+* Linked, one detector drives all channels and the image holds still.
+* Grouped, the channels of each group given to setChannelGroups() share one
+* (see ChannelGroups). Every channel points at a leader, the first channel
+* of the ones it shares a detector with, and the leader's detector row
+* collects their level; independent is every channel leading itself.
+*
+* With metering on, pass 4 also keeps the peak and energy of the audio before
+* and after the gain, so a meter costs no passes of its own. It is the pass
+* that sees the audio itself: the detector may be hearing a key or a delayed
+* copy instead.
+*
+* In mid/side the two channels are mid and side, not left and right. Each
+* has a detector of its own whatever the link mode, and the side compresses
+* against a threshold of its own.
+*/
+template <typename SampleType>
+class CompressorKernel {
+public:
+    enum class LinkMode { independent, linked, grouped };
+
+    // What process() measured on the audio it applied the gain to, over
+    // numValues samples of every channel together.
+    struct Levels {
+        float inputPeak{ 0.f }, outputPeak{ 0.f };
+        double inputSquares{ 0.0 }, outputSquares{ 0.0 };
+        size_t numValues{ 0 };
+    };
+
+    // A group index per channel, for grouped mode. Called before prepare();
+    // a list that doesn't match the channel count puts every channel in one
+    // group.
+    void setChannelGroups(std::vector<size_t> groups) { channelGroups = std::move(groups); }
+
+    void prepare(const juce::dsp::ProcessSpec& spec) {
+        sampleRate = spec.sampleRate;
+        numChannels = spec.numChannels;
+
+        detector.setSize(static_cast<int>(numChannels), static_cast<int>(spec.maximumBlockSize));
+        envelopes.assign(numChannels, 0.f);
+        channelEnvelopes.assign(numChannels, 0.f);
+        leaders.assign(numChannels, 0);
+        updateLeaders();
+
+        attackCoefficient = coefficientFor(attackMs);
+        releaseCoefficient = coefficientFor(releaseMs);
+    }
+
+    // Back to no gain reduction.
+    void reset() {
+        std::fill(envelopes.begin(), envelopes.end(), 0.f);
+    }
+
+    void setThreshold(float thresholdDb) noexcept { threshold = thresholdDb; }
+
+    // The side channel's threshold, used in mid/side only.
+    void setSideThreshold(float thresholdDb) noexcept { sideThreshold = thresholdDb; }
+
+    void setRatio(float ratioToOne) noexcept {
+        jassert(ratioToOne >= 1.f);
+        slope = 1.f / ratioToOne - 1.f;
+    }
+
+    // The width in dB of the bend around the threshold. 0 is a hard knee.
+    void setKnee(float kneeDb) noexcept {
+        knee = juce::jmax(0.f, kneeDb);
+        kneeScale = knee > 0.f ? 0.5f / knee : 0.f;
+    }
+
+    void setAttack(float milliseconds) noexcept {
+        attackMs = milliseconds;
+        attackCoefficient = coefficientFor(attackMs);
+    }
+
+    void setRelease(float milliseconds) noexcept {
+        releaseMs = milliseconds;
+        releaseCoefficient = coefficientFor(releaseMs);
+    }
+
+    // Switching carries the gain reduction over: a detector that takes over
+    // several channels starts from the deepest of them, and a channel that
+    // gets its own starts from the one it shared.
+    void setLinkMode(LinkMode newMode) noexcept {
+        if (newMode != linkMode)
+            relink(newMode, midSide);
+    }
+
+    LinkMode getLinkMode() const noexcept { return linkMode; }
+
+    // Channel 0 is mid and channel 1 side. Only means anything with two
+    // channels; set it before prepare() so the envelopes start in the right
+    // domain.
+    void setMidSide(bool shouldBeMidSide) noexcept {
+        if (shouldBeMidSide != midSide)
+            relink(linkMode, shouldBeMidSide);
+    }
+
+    bool isMidSide() const noexcept { return midSide; }
+
+    // Switching it on starts the levels from nothing.
+    void setMetering(bool shouldMeter) noexcept {
+        if (shouldMeter && !metering)
+            levels = {};
+
+        metering = shouldMeter;
+    }
+
+    // The levels since the last call (or since metering went on), which then
+    // start again from nothing.
+    Levels takeLevels() noexcept {
+        const auto taken = levels;
+        levels = {};
+        return taken;
+    }
+
+    // The gain in dB at the end of the last block, the deepest of any channel.
+    float getGainDb() const noexcept {
+        auto gain = 0.f;
+        for (size_t ch{ 0 }; ch < numChannels; ++ch)
+            gain = std::min(gain, envelopes[leaders[ch]]);
+
+        return gain;
+    }
+
+    // The block can't be longer than the maximumBlockSize given to prepare().
+    void process(const juce::dsp::AudioBlock<SampleType>& block) {
+        process(block, block);
+    }
+
+    // Detects on one block and applies the gain to another of the same
+    // length, e.g. a delayed copy for lookahead. Each output channel takes
+    // the gain of the detector channel with the same index.
+    void process(const juce::dsp::AudioBlock<const SampleType>& detectorInput, const juce::dsp::AudioBlock<SampleType>& output) {
+        const auto channels = juce::jmin(detectorInput.getNumChannels(), output.getNumChannels(), numChannels);
+        const auto numSamples = static_cast<int>(output.getNumSamples());
+        jassert(numSamples <= detector.getNumSamples());
+        jassert(detectorInput.getNumSamples() == output.getNumSamples());
+
+        if (channels == 0 || numSamples == 0)
+            return;
+
+        for (size_t ch = 0; ch < channels; ++ch)
+            juce::FloatVectorOperations::abs(detector.getWritePointer(static_cast<int>(ch)), detectorInput.getChannelPointer(ch), numSamples);
+
+        // each leader's row takes the loudest of its channels
+        for (size_t ch = 0; ch < channels; ++ch) {
+            if (leaders[ch] == ch)
+                continue;
+
+            auto* level = detector.getWritePointer(static_cast<int>(leaders[ch]));
+            juce::FloatVectorOperations::max(level, level, detector.getReadPointer(static_cast<int>(ch)), numSamples);
+        }
+
+        for (size_t ch = 0; ch < channels; ++ch) {
+            if (leaders[ch] != ch)
+                continue;
+
+            auto* gain = detector.getWritePointer(static_cast<int>(ch));
+            computeGain(gain, numSamples, midSide && ch == 1 ? sideThreshold : threshold);
+            envelopes[ch] = smoothGain(gain, numSamples, envelopes[ch]);
+            toLinear(gain, numSamples);
+        }
+
+        for (size_t ch = 0; ch < channels; ++ch) {
+            const auto* gain = detector.getReadPointer(static_cast<int>(leaders[ch]));
+            if (metering)
+                applyAndMeasure(output.getChannelPointer(ch), gain, numSamples);
+            else
+                juce::FloatVectorOperations::multiply(output.getChannelPointer(ch), gain, numSamples);
+        }
+    }
+
+private:
+    void relink(LinkMode newMode, bool newMidSide) noexcept {
+        for (size_t ch{ 0 }; ch < numChannels; ++ch)
+            channelEnvelopes[ch] = envelopes[leaders[ch]];
+
+        linkMode = newMode;
+        midSide = newMidSide;
+        updateLeaders();
+
+        for (size_t ch{ 0 }; ch < numChannels; ++ch) {
+            const auto leader = leaders[ch];
+            envelopes[leader] = leader == ch ? channelEnvelopes[ch] : std::min(envelopes[leader], channelEnvelopes[ch]);
+        }
+    }
+
+    // A channel's leader is the first channel it shares a detector with,
+    // so it is never after the channel itself.
+    void updateLeaders() noexcept {
+        const auto useGroups = channelGroups.size() == numChannels;
+
+        for (size_t ch{ 0 }; ch < numChannels; ++ch) {
+            switch (midSide ? LinkMode::independent : linkMode) {
+                case LinkMode::independent:
+                    leaders[ch] = ch;
+                    break;
+                case LinkMode::linked:
+                    leaders[ch] = 0;
+                    break;
+                case LinkMode::grouped:
+                    leaders[ch] = useGroups ? firstInGroup(ch) : 0;
+                    break;
+            }
+        }
+    }
+
+    size_t firstInGroup(size_t ch) const noexcept {
+        size_t first{ 0 };
+        while (channelGroups[first] != channelGroups[ch])
+            ++first;
+
+        return first;
+    }
+
+    // Level to gain in dB, in place. Below the knee the gain is 0 dB, above
+    // it the level is scaled by the ratio, and inside it the slope bends
+    // quadratically between the two.
+    void computeGain(SampleType* data, int numSamples, float thresholdDb) const noexcept {
+        const auto halfKnee = 0.5f * knee;
+
+        for (int i = 0; i < numSamples; ++i) {
+            const auto over = FastMath::log2(static_cast<float>(data[i])) * FastMath::decibelsPerOctave - thresholdDb;
+            const auto inKnee = std::min(knee, std::max(0.f, over + halfKnee));
+            const auto aboveKnee = std::max(0.f, over - halfKnee);
+            data[i] = static_cast<SampleType>(slope * (inKnee * inKnee * kneeScale + aboveKnee));
+        }
+    }
+
+    // Gain reduction is negative, so moving down is the attack.
+    float smoothGain(SampleType* data, int numSamples, float state) const noexcept {
+        for (int i = 0; i < numSamples; ++i) {
+            const auto target = static_cast<float>(data[i]);
+            const auto coefficient = target < state ? attackCoefficient : releaseCoefficient;
+            state = target + coefficient * (state - target);
+            data[i] = static_cast<SampleType>(state);
+        }
+
+        return state;
+    }
+
+    static void toLinear(SampleType* data, int numSamples) noexcept {
+        constexpr auto octavesPerDecibel = 1.f / FastMath::decibelsPerOctave;
+
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = static_cast<SampleType>(FastMath::exp2(static_cast<float>(data[i]) * octavesPerDecibel));
+    }
+
+    // The gain multiply, taking both levels as it goes.
+    void applyAndMeasure(SampleType* data, const SampleType* gain, int numSamples) noexcept {
+        auto inputPeak = SampleType(0), outputPeak = SampleType(0);
+        auto inputSquares = SampleType(0), outputSquares = SampleType(0);
+
+        for (int i = 0; i < numSamples; ++i) {
+            const auto in = data[i];
+            const auto out = in * gain[i];
+            data[i] = out;
+
+            inputPeak = std::max(inputPeak, std::abs(in));
+            outputPeak = std::max(outputPeak, std::abs(out));
+            inputSquares += in * in;
+            outputSquares += out * out;
+        }
+
+        levels.inputPeak = std::max(levels.inputPeak, static_cast<float>(inputPeak));
+        levels.outputPeak = std::max(levels.outputPeak, static_cast<float>(outputPeak));
+        levels.inputSquares += static_cast<double>(inputSquares);
+        levels.outputSquares += static_cast<double>(outputSquares);
+        levels.numValues += static_cast<size_t>(numSamples);
+    }
+
+    float coefficientFor(float milliseconds) const noexcept {
+        if (milliseconds < 1.0e-3f)
+            return 0.f;
+
+        return static_cast<float>(std::exp(-2.0 * juce::MathConstants<double>::pi * 1000.0 / (milliseconds * sampleRate)));
+    }
+
+    juce::AudioBuffer<SampleType> detector;
+
+    // indexed by channel; only a leader's envelope is used
+    std::vector<float> envelopes, channelEnvelopes;
+    std::vector<size_t> leaders, channelGroups;
+    LinkMode linkMode{ LinkMode::independent };
+    bool midSide{ false }, metering{ false };
+    Levels levels;
+
+    float threshold{ 0.f }, sideThreshold{ 0.f }, slope{ 0.f }, knee{ 0.f }, kneeScale{ 0.f };
+    float attackMs{ 1.f }, releaseMs{ 100.f };
+    float attackCoefficient{ 0.f }, releaseCoefficient{ 0.f };
+
+    size_t numChannels{ 0 };
+    double sampleRate{ 44100.0 };
+};
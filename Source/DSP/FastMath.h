@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    FastMath.h
+    Cheap log2/exp2 approximations for the compressor's gain computer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/*
+* Both split the float into exponent and mantissa bits and fit a cubic to the
+* mantissa, with the ends pinned so the result is continuous across octaves.
+* The error stays under 0.01 dB once scaled to decibels, far below anything a
+* gain computer needs. There are no branches or table lookups, so loops over
+* whole blocks vectorise.
+*/
+namespace FastMath {
+    inline float log2(float x) noexcept {
+        std::uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        const auto exponent = static_cast<float>(static_cast<std::int32_t>(bits >> 23) - 127);
+
+        bits = (bits & 0x007fffffu) | 0x3f800000u;
+        float mantissa;
+        std::memcpy(&mantissa, &bits, sizeof(mantissa));
+
+        // log2(1 + t) for t in [0, 1)
+        const auto t = mantissa - 1.f;
+        return exponent + t * (1.42086454f + t * (-0.57725065f + t * 0.15638611f));
+    }
+
+    // Inputs are clamped to the normal float range, so 0 and denormals come
+    // out of log2() as about -127 and go back in as a tiny positive value.
+    inline float exp2(float x) noexcept {
+        x = x < -126.f ? -126.f : (x > 127.f ? 127.f : x);
+
+        const auto whole = static_cast<float>(static_cast<std::int32_t>(x + 127.f) - 127);
+        const auto t = x - whole;
+
+        // 2^t for t in [0, 1)
+        const auto fraction = 1.f + t * (0.69592847f + t * (0.22494631f + t * 0.07912522f));
+
+        auto bits = static_cast<std::uint32_t>(static_cast<std::int32_t>(whole) + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+
+        return scale * fraction;
+    }
+
+    inline constexpr float decibelsPerOctave = 6.0205999f; // 20 log10(2)
+}
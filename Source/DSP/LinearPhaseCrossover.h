@@ -0,0 +1,507 @@
+/*
+  ==============================================================================
+
+    LinearPhaseCrossover.h
+    FIR band splitter using uniformly partitioned FFT convolution.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* A drop-in for LinkwitzRileyCrossover that delays every band by the same
+* amount instead of shifting its phase, so transients around a split stay
+* where they were even when the bands end up at different gains.
+*
+* Each band's filter has the magnitude response the Linkwitz-Riley tree
+* gives that band and no phase at all. LR4 lowpass and highpass magnitudes
+* add up to exactly one, so the bands still sum back flat, now to a plain
+* delay. The kernels come from sampling those magnitudes on an FFT grid of
+* kernelSize points, centring the result and windowing it; the window is 1
+* in the middle, so the sum of the bands stays a single impulse.
+*
+* Convolution is uniformly partitioned overlap-save: the input is cut into
+* frames of partitionSize samples, each frame is transformed once per
+* channel, and every band multiplies the spectra of the last few frames with
+* its kernel partitions and transforms back once. The latency is half the
+* kernel plus one partition.
+*
+* When a crossover moves, the process-wide CrossoverDesigner thread designs
+* new kernels and hands them over through an atomic exchange of buffer
+* indices, so neither side waits. The designer sleeps until requestDesign()
+* wakes it from the message thread. The audio thread crossfades from the old
+* kernels to the new ones over the next frame. Everything is sized in
+* prepare().
+*
+* A sidechain split alongside the input goes through the same kernels, and
+* only adds its own transforms.
+*
+* The convolution itself runs in float, as juce::dsp::FFT does. Spectra are
+* kept as a plane of real parts followed by a plane of imaginary parts, each
+* padded to whole SIMDRegisters, so the complex multiply-accumulate over all
+* the partitions, the bulk of the work, runs a register of bins at a time.
+* The FFT's interleaved bins are split into planes once per transform and
+* put back together once per inverse.
+*/
+/*
+* One thread designs the kernels of every linear phase crossover in the
+* process; hold it through a juce::SharedResourcePointer. It sleeps until
+* requestDesign(), then lets every registered crossover design whatever it
+* was asked for since its last design.
+*/
+class CrossoverDesigner : private juce::Thread {
+public:
+    struct Client {
+        virtual ~Client() = default;
+
+        // Designer thread: designs new kernels if any were asked for.
+        virtual void designRequested() = 0;
+    };
+
+    CrossoverDesigner() : juce::Thread("Crossover designer") {
+        startThread(juce::Thread::Priority::low);
+    }
+
+    ~CrossoverDesigner() override { stopThread(2000); }
+
+    // Message thread. remove() waits for a design the client is in the
+    // middle of, so its buffers can change once it returns.
+    void add(Client& client) {
+        const juce::ScopedLock sl(lock);
+        clients.addIfNotAlreadyThere(&client);
+    }
+
+    void remove(Client& client) {
+        const juce::ScopedLock sl(lock);
+        clients.removeFirstMatchingValue(&client);
+    }
+
+    // Off the audio thread; a request made while a design runs wakes the
+    // designer again once it is done.
+    void requestDesign() { notify(); }
+
+private:
+    void run() override {
+        while (!threadShouldExit()) {
+            wait(-1);
+
+            const juce::ScopedLock sl(lock);
+            for (auto* client : clients)
+                client->designRequested();
+        }
+    }
+
+    juce::CriticalSection lock;
+    juce::Array<Client*> clients;
+};
+
+template <typename SampleType, size_t NumBands = 3>
+class LinearPhaseCrossover : private CrossoverDesigner::Client {
+public:
+    static_assert(NumBands >= 2, "a crossover needs at least two bands");
+
+    static constexpr size_t numBands = NumBands;
+    static constexpr size_t numSplits = numBands - 1;
+
+    using BandBlocks = std::array<juce::dsp::AudioBlock<SampleType>, numBands>;
+
+    static constexpr int partitionOrder = 8;
+    static constexpr size_t partitionSize = size_t(1) << partitionOrder;
+
+    // The kernels span about this long, rounded up to a power of two.
+    static constexpr double kernelSeconds = 0.08;
+
+    LinearPhaseCrossover() {
+        // a decade apart from 100 Hz until the first setCrossoverFrequency()
+        for (size_t split = 0; split < numSplits; ++split)
+            requestedFrequencies[split].store(static_cast<float>(100.0 * std::pow(10.0, static_cast<double>(split))));
+    }
+
+    ~LinearPhaseCrossover() override { designer->remove(*this); }
+
+    // numKeyChannels sizes the sidechain's buffers; 0 if there is no key.
+    void prepare(const juce::dsp::ProcessSpec& spec, size_t numKeyChannels = 0) {
+        designer->remove(*this);
+
+        sampleRate = spec.sampleRate;
+
+        const auto kernelOrder = juce::jmax(10, juce::roundToInt(std::ceil(std::log2(sampleRate * kernelSeconds))));
+        kernelSize = size_t(1) << kernelOrder;
+        numPartitions = kernelSize / partitionSize;
+
+        designFft = std::make_unique<juce::dsp::FFT>(kernelOrder);
+        designBuffer.assign(2 * kernelSize, 0.f);
+        designFrame.assign(4 * partitionSize, 0.f);
+
+        for (auto& set : kernels)
+            set.assign(numBands * numPartitions * spectrumVecs, Vec{});
+
+        preparePath(main, spec.numChannels);
+        preparePath(key, numKeyChannels);
+        frame.assign(4 * partitionSize, 0.f);
+        accumulator.assign(spectrumVecs, Vec{});
+        fadeFrame.assign(partitionSize, 0.f);
+
+        for (size_t split = 0; split < numSplits; ++split)
+            designedFrequencies[split] = requestedFrequencies[split].load();
+
+        // the first kernels are ready before the first block
+        design(kernels[0], designedFrequencies);
+        active = 0;
+        spare = 1;
+        ready.store(2);
+        designerFree = 3;
+        designedRequest = requestCount.load();
+
+        reset();
+        designer->add(*this);
+    }
+
+    // Half the kernel for the linear phase, plus one partition of buffering.
+    size_t getLatencySamples() const noexcept { return kernelSize / 2 + partitionSize; }
+
+    // How long the output rings on past the latency: the kernel's second half.
+    size_t getRingingSamples() const noexcept { return kernelSize / 2; }
+
+    void reset() {
+        clear(main);
+        clear(key);
+        linePosition = 0;
+        framePosition = 0;
+    }
+
+    // Clears only the sidechain's buffers, e.g. when a key that wasn't being
+    // split is needed again.
+    void resetKey() { clear(key); }
+
+    // Leaves the designer while the crossover isn't in use.
+    void release() { designer->remove(*this); }
+
+    // Split 0 is the lowest crossover. Only a frequency that differs from
+    // the last one asks for new kernels, designed once requestDesign() is
+    // called. Any thread.
+    void setCrossoverFrequency(size_t split, SampleType frequency) noexcept {
+        jassert(split < numSplits);
+        jassert(frequency > 0 && frequency < static_cast<SampleType>(sampleRate * 0.5));
+
+        const auto value = static_cast<float>(frequency);
+        if (requestedFrequencies[split].load(std::memory_order_relaxed) != value) {
+            requestedFrequencies[split].store(value, std::memory_order_relaxed);
+            requestCount.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // Message thread: wakes the designer for the frequencies set so far.
+    void requestDesign() { designer->requestDesign(); }
+
+    // The input may alias one of the band blocks: each stretch of samples
+    // is read before any band is written.
+    void process(const juce::dsp::AudioBlock<const SampleType>& input, const BandBlocks& bands) {
+        const auto numSamples = input.getNumSamples();
+        const auto channels = juce::jmin(input.getNumChannels(), main.numChannels);
+        jassert(input.getNumChannels() <= main.numChannels);
+
+        for (size_t done = 0; done < numSamples;) {
+            const auto length = juce::jmin(numSamples - done, partitionSize - framePosition);
+            exchange(main, input, bands, done, length, channels);
+            advance(length, channels, 0);
+            done += length;
+        }
+    }
+
+    // Splits a sidechain of the same length into keyBands as well, through
+    // the input's kernels.
+    void process(const juce::dsp::AudioBlock<const SampleType>& input, const BandBlocks& bands,
+                 const juce::dsp::AudioBlock<const SampleType>& keyInput, const BandBlocks& keyBands) {
+        const auto numSamples = input.getNumSamples();
+        const auto channels = juce::jmin(input.getNumChannels(), main.numChannels);
+        const auto keyChannels = juce::jmin(keyInput.getNumChannels(), key.numChannels);
+        jassert(input.getNumChannels() <= main.numChannels && keyInput.getNumChannels() <= key.numChannels);
+        jassert(keyInput.getNumSamples() == numSamples);
+
+        for (size_t done = 0; done < numSamples;) {
+            const auto length = juce::jmin(numSamples - done, partitionSize - framePosition);
+            exchange(main, input, bands, done, length, channels);
+            exchange(key, keyInput, keyBands, done, length, keyChannels);
+            advance(length, channels, keyChannels);
+            done += length;
+        }
+    }
+
+private:
+    // The buffers of one signal being split: the input, or the key.
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+   #else
+    using Vec = float;
+   #endif
+
+    static constexpr size_t laneWidth = sizeof(Vec) / sizeof(float);
+
+    // the complex bins of a 2 * partitionSize point transform, as a real and
+    // an imaginary plane of planeVecs registers each
+    static constexpr size_t numBins = partitionSize + 1;
+    static constexpr size_t planeVecs = (numBins + laneWidth - 1) / laneWidth;
+    static constexpr size_t spectrumVecs = 2 * planeVecs;
+
+    struct Path {
+        std::vector<Vec> frequencyDomainLine;
+        std::vector<float> inputFrames, outputFrames;
+        size_t numChannels{ 0 };
+    };
+
+    static constexpr int newKernels = 4;
+    static constexpr int indexMask = 3;
+
+    void preparePath(Path& path, size_t numChannels) {
+        path.numChannels = numChannels;
+        path.frequencyDomainLine.assign(numChannels * numPartitions * spectrumVecs, Vec{});
+        path.inputFrames.assign(numChannels * 2 * partitionSize, 0.f);
+        path.outputFrames.assign(numBands * numChannels * partitionSize, 0.f);
+    }
+
+    static void clear(Path& path) {
+        std::fill(path.frequencyDomainLine.begin(), path.frequencyDomainLine.end(), Vec{});
+        std::fill(path.inputFrames.begin(), path.inputFrames.end(), 0.f);
+        std::fill(path.outputFrames.begin(), path.outputFrames.end(), 0.f);
+    }
+
+    static float* inputFrame(Path& path, size_t ch) noexcept { return path.inputFrames.data() + ch * 2 * partitionSize; }
+
+    static float* outputFrame(Path& path, size_t band, size_t ch) noexcept {
+        return path.outputFrames.data() + (band * path.numChannels + ch) * partitionSize;
+    }
+
+    Vec* lineSpectrum(Path& path, size_t ch, size_t slot) noexcept {
+        return path.frequencyDomainLine.data() + (ch * numPartitions + slot) * spectrumVecs;
+    }
+
+    static Vec* kernelSpectrum(std::vector<Vec>& set, size_t numPartitions, size_t band, size_t partition) noexcept {
+        return set.data() + (band * numPartitions + partition) * spectrumVecs;
+    }
+
+    static const Vec* kernelSpectrum(const std::vector<Vec>& set, size_t numPartitions, size_t band, size_t partition) noexcept {
+        return set.data() + (band * numPartitions + partition) * spectrumVecs;
+    }
+
+    // From the FFT's interleaved bins to the two planes, and back. The
+    // padding at the end of each plane stays zero.
+    static void toPlanes(const float* interleaved, Vec* spectrum) noexcept {
+        auto* re = reinterpret_cast<float*>(spectrum);
+        auto* im = re + planeVecs * laneWidth;
+
+        for (size_t bin = 0; bin < numBins; ++bin) {
+            re[bin] = interleaved[2 * bin];
+            im[bin] = interleaved[2 * bin + 1];
+        }
+    }
+
+    static void toInterleaved(const Vec* spectrum, float* interleaved) noexcept {
+        const auto* re = reinterpret_cast<const float*>(spectrum);
+        const auto* im = re + planeVecs * laneWidth;
+
+        for (size_t bin = 0; bin < numBins; ++bin) {
+            interleaved[2 * bin] = re[bin];
+            interleaved[2 * bin + 1] = im[bin];
+        }
+    }
+
+    //==============================================================================
+    // audio thread
+
+    // Takes in length samples of the input and hands out as many of the
+    // last frame's bands. Every sample is read before any band is written.
+    void exchange(Path& path, const juce::dsp::AudioBlock<const SampleType>& input, const BandBlocks& bands,
+                  size_t offset, size_t length, size_t channels) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+            const auto* source = input.getChannelPointer(ch) + offset;
+            auto* dest = inputFrame(path, ch) + partitionSize + framePosition;
+
+            for (size_t i = 0; i < length; ++i)
+                dest[i] = static_cast<float>(source[i]);
+        }
+
+        for (size_t band = 0; band < numBands; ++band) {
+            for (size_t ch = 0; ch < channels; ++ch) {
+                const auto* source = outputFrame(path, band, ch) + framePosition;
+                auto* dest = bands[band].getChannelPointer(ch) + offset;
+
+                for (size_t i = 0; i < length; ++i)
+                    dest[i] = static_cast<SampleType>(source[i]);
+            }
+        }
+    }
+
+    void advance(size_t length, size_t channels, size_t keyChannels) {
+        framePosition += length;
+        if (framePosition < partitionSize)
+            return;
+
+        processFrame(channels, keyChannels);
+        framePosition = 0;
+    }
+
+    void processFrame(size_t channels, size_t keyChannels) {
+        // pick up kernels the designer has finished, keeping the old ones
+        // for this frame's crossfade
+        auto previous = -1;
+        if (ready.load(std::memory_order_acquire) & newKernels) {
+            const auto next = ready.exchange(spare, std::memory_order_acq_rel) & indexMask;
+            previous = active;
+            spare = active;
+            active = next;
+        }
+
+        processFrame(main, channels, previous);
+        processFrame(key, keyChannels, previous);
+
+        linePosition = (linePosition + 1) % numPartitions;
+    }
+
+    void processFrame(Path& path, size_t channels, int previous) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+            std::copy_n(inputFrame(path, ch), 2 * partitionSize, frame.data());
+            std::fill(frame.begin() + static_cast<std::ptrdiff_t>(2 * partitionSize), frame.end(), 0.f);
+            partitionFft.performRealOnlyForwardTransform(frame.data(), true);
+            toPlanes(frame.data(), lineSpectrum(path, ch, linePosition));
+
+            // overlap-save keeps the last partition as the first half of the next frame
+            std::copy_n(inputFrame(path, ch) + partitionSize, partitionSize, inputFrame(path, ch));
+        }
+
+        for (size_t band = 0; band < numBands; ++band) {
+            for (size_t ch = 0; ch < channels; ++ch) {
+                auto* out = outputFrame(path, band, ch);
+                convolve(path, kernels[static_cast<size_t>(active)], band, ch, out);
+
+                if (previous >= 0) {
+                    convolve(path, kernels[static_cast<size_t>(previous)], band, ch, fadeFrame.data());
+
+                    for (size_t i = 0; i < partitionSize; ++i) {
+                        const auto fade = static_cast<float>(i + 1) / static_cast<float>(partitionSize);
+                        out[i] = fadeFrame[i] + (out[i] - fadeFrame[i]) * fade;
+                    }
+                }
+            }
+        }
+    }
+
+    // Sums every kernel partition times the spectrum of the frame that far
+    // back, and writes the valid half of the result.
+    void convolve(Path& path, const std::vector<Vec>& set, size_t band, size_t ch, float* dest) {
+        std::fill(accumulator.begin(), accumulator.end(), Vec{});
+        auto* accRe = accumulator.data();
+        auto* accIm = accRe + planeVecs;
+
+        for (size_t partition = 0; partition < numPartitions; ++partition) {
+            const auto slot = (linePosition + numPartitions - partition) % numPartitions;
+            const auto* xRe = lineSpectrum(path, ch, slot);
+            const auto* xIm = xRe + planeVecs;
+            const auto* hRe = kernelSpectrum(set, numPartitions, band, partition);
+            const auto* hIm = hRe + planeVecs;
+
+            for (size_t v = 0; v < planeVecs; ++v) {
+                accRe[v] += xRe[v] * hRe[v] - xIm[v] * hIm[v];
+                accIm[v] += xRe[v] * hIm[v] + xIm[v] * hRe[v];
+            }
+        }
+
+        toInterleaved(accumulator.data(), frame.data());
+        std::fill(frame.begin() + static_cast<std::ptrdiff_t>(2 * numBins), frame.end(), 0.f);
+        partitionFft.performRealOnlyInverseTransform(frame.data());
+        std::copy_n(frame.data() + partitionSize, partitionSize, dest);
+    }
+
+    //==============================================================================
+    // designer thread
+
+    void designRequested() override {
+        const auto request = requestCount.load(std::memory_order_acquire);
+        if (request == designedRequest)
+            return;
+
+        designedRequest = request;
+        for (size_t split = 0; split < numSplits; ++split)
+            designedFrequencies[split] = requestedFrequencies[split].load(std::memory_order_relaxed);
+
+        design(kernels[static_cast<size_t>(designerFree)], designedFrequencies);
+        designerFree = ready.exchange(designerFree | newKernels, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // The zero phase magnitude of each band, centred and windowed, then cut
+    // into partitions and transformed.
+    void design(std::vector<Vec>& set, const std::array<float, numSplits>& frequencies) {
+        const auto numBins = kernelSize / 2 + 1;
+        const auto binHz = sampleRate / static_cast<double>(kernelSize);
+
+        // LR4 lowpass magnitude; the highpass is one minus it
+        auto lowpass = [](double frequency, double crossover) {
+            const auto ratio = frequency / crossover;
+            const auto r2 = ratio * ratio;
+            return 1.0 / (1.0 + r2 * r2);
+        };
+
+        for (size_t band = 0; band < numBands; ++band) {
+            std::fill(designBuffer.begin(), designBuffer.end(), 0.f);
+
+            for (size_t bin = 0; bin < numBins; ++bin) {
+                const auto frequency = static_cast<double>(bin) * binHz;
+                auto magnitude = band < numSplits ? lowpass(frequency, frequencies[band]) : 1.0;
+
+                for (size_t split = 0; split < band; ++split)
+                    magnitude *= 1.0 - lowpass(frequency, frequencies[split]);
+
+                designBuffer[2 * bin] = static_cast<float>(magnitude);
+            }
+
+            designFft->performRealOnlyInverseTransform(designBuffer.data());
+
+            // centre the impulse response and window it (1 in the middle)
+            std::rotate(designBuffer.begin(), designBuffer.begin() + static_cast<std::ptrdiff_t>(kernelSize / 2),
+                        designBuffer.begin() + static_cast<std::ptrdiff_t>(kernelSize));
+
+            for (size_t n = 0; n < kernelSize; ++n) {
+                const auto phase = juce::MathConstants<double>::twoPi * static_cast<double>(n) / static_cast<double>(kernelSize);
+                designBuffer[n] *= static_cast<float>(0.5 - 0.5 * std::cos(phase));
+            }
+
+            for (size_t partition = 0; partition < numPartitions; ++partition) {
+                std::fill(designFrame.begin(), designFrame.end(), 0.f);
+                std::copy_n(designBuffer.data() + partition * partitionSize, partitionSize, designFrame.data());
+                designPartitionFft.performRealOnlyForwardTransform(designFrame.data(), true);
+
+                toPlanes(designFrame.data(), kernelSpectrum(set, numPartitions, band, partition));
+            }
+        }
+    }
+
+    double sampleRate{ 44100.0 };
+    size_t kernelSize{ 0 }, numPartitions{ 0 };
+
+    // four kernel sets: the audio thread's active one and its spare, the
+    // designer's, and the one in 'ready' (flagged newKernels once designed)
+    std::array<std::vector<Vec>, 4> kernels;
+    std::atomic<int> ready{ 2 };
+    int active{ 0 }, spare{ 1 }, designerFree{ 3 };
+
+    std::array<std::atomic<float>, numSplits> requestedFrequencies{};
+    std::atomic<juce::uint32> requestCount{ 0 };
+
+    // audio thread
+    juce::dsp::FFT partitionFft{ partitionOrder + 1 };
+    Path main, key;
+    std::vector<float> frame, fadeFrame;
+    std::vector<Vec> accumulator;
+    size_t linePosition{ 0 }, framePosition{ 0 };
+
+    // designer thread (and prepare())
+    juce::SharedResourcePointer<CrossoverDesigner> designer;
+    std::unique_ptr<juce::dsp::FFT> designFft;
+    juce::dsp::FFT designPartitionFft{ partitionOrder + 1 };
+    std::vector<float> designBuffer, designFrame;
+    std::array<float, numSplits> designedFrequencies{};
+    juce::uint32 designedRequest{ 0 };
+};
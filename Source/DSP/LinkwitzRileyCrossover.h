@@ -0,0 +1,337 @@
+/*
+  ==============================================================================
+
+    LinkwitzRileyCrossover.h
+    Single pass Linkwitz-Riley (LR4) crossover for the band splitter.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CoefficientCache.h"
+
+/*
+* Splits the input into NumBands bands in one pass over the block. Split k
+* sits between band k and band k + 1; the remainder above the last split is
+* the top band. Every band is run through the allpass of each split above its
+* own, so all bands share the same phase and sum back flat:
+*
+*   band k   = AP(N-2) ... AP(k+1) LP(k) HP(k-1) ... HP(0) in
+*   band N-1 = HP(N-2) ... HP(0) in
+*
+* For three bands that is the tree the processor used to build out of five
+* LinkwitzRileyFilters:
+*
+*   low  = AP2(LP1(in))
+*   mid  = LP2(HP1(in))
+*   high = HP2(HP1(in))
+*
+* Every split uses the TPT sections of juce::dsp::LinkwitzRileyFilter. The
+* highpass side of a split is taken as allpass - lowpass, the same identity
+* LinkwitzRileyFilter uses in its two output processSample(), so a split only
+* runs two sections instead of four.
+*
+* Crossover changes are ramped: while a frequency is moving the block is
+* worked through in sub-blocks of coefficientUpdateInterval samples with the
+* coefficients recomputed for each one, and left alone otherwise. Settled
+* frequencies take their coefficients from the process-wide CoefficientCache,
+* so a reset (or waking up from a passthrough or a silence) looks them up
+* rather than working them out again. prepare() fills the cache in for the
+* frequencies it starts on, and cacheCoefficients() for the ones it settles
+* on later.
+*
+* A sidechain can be split alongside the input, through filters of its own
+* that share every split's coefficients, smoothing and sub-block schedule
+* with the input's, so the key bands cost the filtering and nothing more.
+*
+* The filter state is stored struct-of-arrays with one SIMD lane per signal
+* and channel. The lanes of a stage hold the signal being split first,
+* followed by the bands that were already split off and only need that
+* stage's allpass, so the allpass and the first section of the split share
+* registers (SSE/NEON, or AVX when SIMDRegister is built for it).
+*/
+template <typename SampleType, size_t NumBands = 3>
+class LinkwitzRileyCrossover {
+public:
+    static_assert(NumBands >= 2, "a crossover needs at least two bands");
+
+    static constexpr size_t numBands = NumBands;
+    static constexpr size_t numSplits = numBands - 1;
+
+    using BandBlocks = std::array<juce::dsp::AudioBlock<SampleType>, numBands>;
+
+    static constexpr double frequencyRampSeconds = 0.05;
+    static constexpr size_t coefficientUpdateInterval = 32;
+
+    // numKeyChannels sizes the sidechain filters; 0 if there is no key.
+    void prepare(const juce::dsp::ProcessSpec& spec, size_t numKeyChannels = 0) {
+        sampleRate = spec.sampleRate;
+
+        for (auto& stage : stages) {
+            stage.frequency.reset(sampleRate, frequencyRampSeconds);
+            cacheCoefficients(stage.frequency.getTargetValue());
+        }
+
+        preparePath(main, spec.numChannels);
+        preparePath(key, numKeyChannels);
+
+        reset();
+    }
+
+    // Clears the filters and jumps straight to the target frequencies.
+    void reset() {
+        for (auto& stage : stages) {
+            stage.frequency.setCurrentAndTargetValue(stage.frequency.getTargetValue());
+            updateCoefficients(stage);
+        }
+
+        clear(main);
+        clear(key);
+    }
+
+    // Clears only the sidechain filters, e.g. when a key that wasn't being
+    // split is needed again.
+    void resetKey() { clear(key); }
+
+    // Off the audio thread, at the prepared sample rate: puts a frequency's
+    // coefficients in the cache, so the audio thread finds them when a split
+    // settles on it.
+    void cacheCoefficients(SampleType frequency) {
+        cache->get(sampleRate, static_cast<double>(frequency));
+    }
+
+    // Split 0 is the lowest crossover. Setting the frequency it is already
+    // heading for costs nothing.
+    void setCrossoverFrequency(size_t split, SampleType frequency) {
+        jassert(split < numSplits);
+        jassert(frequency > 0 && frequency < static_cast<SampleType>(sampleRate * 0.5));
+
+        stages[split].frequency.setTargetValue(frequency);
+    }
+
+    bool isSmoothing() const noexcept {
+        for (auto& stage : stages)
+            if (stage.frequency.isSmoothing())
+                return true;
+
+        return false;
+    }
+
+    // The input may alias one of the band blocks: every sample is read before
+    // any band is written.
+    void process(const juce::dsp::AudioBlock<const SampleType>& input, const BandBlocks& bands) {
+        const auto numSamples = input.getNumSamples();
+        const auto channels = bindPath(main, input, bands);
+
+        for (size_t start = 0; start < numSamples;) {
+            const auto length = advanceCoefficients(numSamples - start);
+            processSamples(main, start, length, channels);
+            start += length;
+        }
+    }
+
+    // Splits a sidechain of the same length into keyBands as well, with the
+    // coefficients of the input's split.
+    void process(const juce::dsp::AudioBlock<const SampleType>& input, const BandBlocks& bands,
+                 const juce::dsp::AudioBlock<const SampleType>& keyInput, const BandBlocks& keyBands) {
+        const auto numSamples = input.getNumSamples();
+        jassert(keyInput.getNumSamples() == numSamples);
+
+        const auto channels = bindPath(main, input, bands);
+        const auto keyChannels = bindPath(key, keyInput, keyBands);
+
+        for (size_t start = 0; start < numSamples;) {
+            const auto length = advanceCoefficients(numSamples - start);
+            processSamples(main, start, length, channels);
+            processSamples(key, start, length, keyChannels);
+            start += length;
+        }
+    }
+
+private:
+#if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+    static Vec broadcast(SampleType value) { return Vec::expand(value); }
+    static Vec load(const SampleType* source) { return Vec::fromRawArray(source); }
+    static void store(const Vec& value, SampleType* dest) { value.copyToRawArray(dest); }
+#else
+    using Vec = SampleType;
+
+    static Vec broadcast(SampleType value) { return value; }
+    static Vec load(const SampleType* source) { return *source; }
+    static void store(const Vec& value, SampleType* dest) { *dest = value; }
+#endif
+    static constexpr size_t laneWidth = sizeof(Vec) / sizeof(SampleType);
+
+    // A split's coefficients, shared by every signal it splits.
+    struct Stage {
+        Vec g{}, h{}, r2PlusG{};
+        juce::SmoothedValue<SampleType, juce::ValueSmoothingTypes::Multiplicative> frequency{ SampleType(1000) };
+    };
+
+    // The filter state of one signal being split: the input, or the key.
+    struct Path {
+        struct State {
+            std::vector<Vec> s1, s2, s3, s4;
+            size_t numGroups{ 0 };
+        };
+
+        std::array<State, numSplits> states;
+        std::vector<Vec> lanes, lowLanes, splitMask;
+        std::vector<const SampleType*> inputs;
+        std::vector<SampleType*> outputs;
+        size_t numChannels{ 0 }, numSplitGroups{ 0 };
+    };
+
+    static size_t numGroupsFor(size_t numLanes) { return (numLanes + laneWidth - 1) / laneWidth; }
+    static SampleType* laneData(std::vector<Vec>& v) { return reinterpret_cast<SampleType*>(v.data()); }
+
+    static void preparePath(Path& path, size_t numChannels) {
+        path.numChannels = numChannels;
+        path.numSplitGroups = numGroupsFor(numChannels);
+
+        path.lanes.assign(numGroupsFor(numBands * numChannels), broadcast(0));
+        path.lowLanes.assign(path.numSplitGroups, broadcast(0));
+        path.splitMask.assign(path.numSplitGroups, broadcast(0));
+
+        auto* mask = laneData(path.splitMask);
+        for (size_t ch = 0; ch < numChannels; ++ch)
+            mask[ch] = SampleType(1);
+
+        for (size_t split = 0; split < numSplits; ++split) {
+            auto& state = path.states[split];
+            state.numGroups = numGroupsFor((split + 1) * numChannels);
+            state.s1.resize(state.numGroups);
+            state.s2.resize(state.numGroups);
+            state.s3.resize(path.numSplitGroups);
+            state.s4.resize(path.numSplitGroups);
+        }
+
+        path.inputs.resize(numChannels);
+        path.outputs.resize(numBands * numChannels);
+    }
+
+    static void clear(Path& path) {
+        for (auto& state : path.states)
+            for (auto* s : { &state.s1, &state.s2, &state.s3, &state.s4 })
+                std::fill(s->begin(), s->end(), broadcast(0));
+
+        std::fill(path.lanes.begin(), path.lanes.end(), broadcast(0));
+    }
+
+    // Points the path at this block's channels; returns how many it splits.
+    static size_t bindPath(Path& path, const juce::dsp::AudioBlock<const SampleType>& input, const BandBlocks& bands) {
+        const auto numSamples = input.getNumSamples();
+        const auto channels = juce::jmin(input.getNumChannels(), path.numChannels);
+        jassert(input.getNumChannels() <= path.numChannels);
+
+        for (size_t ch = 0; ch < channels; ++ch) {
+            path.inputs[ch] = input.getChannelPointer(ch);
+            for (size_t band = 0; band < numBands; ++band) {
+                jassert(bands[band].getNumSamples() >= numSamples);
+                path.outputs[band * path.numChannels + ch] = bands[band].getChannelPointer(ch);
+            }
+        }
+
+        juce::ignoreUnused(numSamples);
+        return channels;
+    }
+
+    // How much of what is left can run on the current coefficients, stepping
+    // any moving frequencies on by that much.
+    size_t advanceCoefficients(size_t remaining) {
+        if (!isSmoothing())
+            return remaining;
+
+        const auto length = juce::jmin(remaining, coefficientUpdateInterval);
+
+        for (auto& stage : stages) {
+            if (stage.frequency.isSmoothing()) {
+                stage.frequency.skip(static_cast<int>(length));
+                updateCoefficients(stage);
+            }
+        }
+
+        return length;
+    }
+
+    // The steps of a ramp are unlikely to come up again, so only a settled
+    // frequency is looked up.
+    void updateCoefficients(Stage& stage) {
+        const auto frequency = static_cast<double>(stage.frequency.getCurrentValue());
+
+        CoefficientCache::Coefficients coefficients;
+        if (stage.frequency.isSmoothing() || !cache->find(sampleRate, frequency, coefficients))
+            coefficients = CoefficientCache::compute(sampleRate, frequency);
+
+        stage.g = broadcast(static_cast<SampleType>(coefficients.g));
+        stage.h = broadcast(static_cast<SampleType>(coefficients.h));
+        stage.r2PlusG = broadcast(static_cast<SampleType>(coefficients.r2PlusG));
+    }
+
+    void processSamples(Path& path, size_t start, size_t numSamples, size_t channels) {
+        const auto numChannels = path.numChannels;
+        auto* signal = laneData(path.lanes);
+        auto* low = laneData(path.lowLanes);
+
+        for (size_t n = start; n < start + numSamples; ++n) {
+            for (size_t ch = 0; ch < channels; ++ch)
+                signal[ch] = path.inputs[ch][n];
+
+            for (size_t split = 0; split < numSplits; ++split) {
+                processStage(stages[split], path.states[split], path, signal, low);
+
+                // the lowpass side of this split becomes band 'split'
+                std::copy(low, low + numChannels, signal + (split + 1) * numChannels);
+            }
+
+            // the last remainder is the top band, the rest sit behind it in band order
+            for (size_t ch = 0; ch < channels; ++ch) {
+                path.outputs[(numBands - 1) * numChannels + ch][n] = signal[ch];
+                for (size_t band = 0; band + 1 < numBands; ++band)
+                    path.outputs[band * numChannels + ch][n] = signal[(band + 1) * numChannels + ch];
+            }
+        }
+    }
+
+    void processStage(const Stage& stage, typename Path::State& state, const Path& path, SampleType* signal, SampleType* low) {
+        for (size_t i = 0; i < state.numGroups; ++i) {
+            auto* group = signal + i * laneWidth;
+            const auto x = load(group);
+
+            const auto yH = (x - stage.r2PlusG * state.s1[i] - state.s2[i]) * stage.h;
+            const auto yB = stage.g * yH + state.s1[i];
+            state.s1[i] = stage.g * yH + yB;
+            const auto yL = stage.g * yB + state.s2[i];
+            state.s2[i] = stage.g * yB + yL;
+
+            const auto allpass = yL - root2 * yB + yH;
+
+            if (i < path.numSplitGroups) {
+                const auto yH2 = (yL - stage.r2PlusG * state.s3[i] - state.s4[i]) * stage.h;
+                const auto yB2 = stage.g * yH2 + state.s3[i];
+                state.s3[i] = stage.g * yH2 + yB2;
+                const auto yL2 = stage.g * yB2 + state.s4[i];
+                state.s4[i] = stage.g * yB2 + yL2;
+
+                // highpass = allpass - lowpass on the lanes being split,
+                // plain allpass on any band lanes sharing the register
+                store(allpass - yL2 * path.splitMask[i], group);
+                store(yL2, low + i * laneWidth);
+            }
+            else {
+                store(allpass, group);
+            }
+        }
+    }
+
+    std::array<Stage, numSplits> stages;
+    Path main, key;
+    juce::SharedResourcePointer<CoefficientCache> cache;
+
+    const Vec root2 = broadcast(static_cast<SampleType>(juce::MathConstants<double>::sqrt2));
+    double sampleRate{ 44100.0 };
+};
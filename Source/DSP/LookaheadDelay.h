@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    LookaheadDelay.h
+    Circular delay line over storage owned by someone else.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* The multiband engine gives every band a slice of one arena instead of a
+* buffer each (see MultiBandCompressor::prepare()), so this only keeps the
+* positions. Blocks are pushed whole and read back at any delay up to the
+* one it was sized for, as at most two copies per channel around the wrap.
+*/
+template <typename SampleType>
+class LookaheadDelay {
+public:
+    static size_t getStorageSize(size_t numChannels, size_t maxDelay, size_t maxBlockSize) noexcept {
+        return numChannels * (maxDelay + maxBlockSize);
+    }
+
+    // storage has to hold getStorageSize() samples and outlive the delay.
+    void setStorage(SampleType* storage, size_t channels, size_t maxDelay, size_t maxBlockSize) noexcept {
+        data = storage;
+        numChannels = channels;
+        length = maxDelay + maxBlockSize;
+        reset();
+    }
+
+    void reset() noexcept {
+        if (data != nullptr)
+            std::fill(data, data + numChannels * length, SampleType(0));
+
+        writePosition = 0;
+    }
+
+    void push(const juce::dsp::AudioBlock<const SampleType>& block) noexcept {
+        const auto numSamples = block.getNumSamples();
+        jassert(numSamples <= length);
+
+        for (size_t ch = 0; ch < juce::jmin(numChannels, block.getNumChannels()); ++ch)
+            copyAround(block.getChannelPointer(ch), channel(ch), writePosition, numSamples);
+
+        writePosition = (writePosition + numSamples) % length;
+    }
+
+    // Fills dest with the last pushed block as it was 'delay' samples ago.
+    void read(size_t delay, const juce::dsp::AudioBlock<SampleType>& dest) const noexcept {
+        const auto numSamples = dest.getNumSamples();
+        jassert(delay + numSamples <= length);
+
+        const auto start = (writePosition + length - numSamples - delay) % length;
+
+        for (size_t ch = 0; ch < juce::jmin(numChannels, dest.getNumChannels()); ++ch) {
+            const auto* source = channel(ch);
+            auto* out = dest.getChannelPointer(ch);
+            const auto first = juce::jmin(numSamples, length - start);
+
+            std::copy_n(source + start, first, out);
+            std::copy_n(source, numSamples - first, out + first);
+        }
+    }
+
+private:
+    SampleType* channel(size_t ch) const noexcept { return data + ch * length; }
+
+    void copyAround(const SampleType* source, SampleType* ring, size_t position, size_t numSamples) const noexcept {
+        const auto first = juce::jmin(numSamples, length - position);
+
+        std::copy_n(source, first, ring + position);
+        std::copy_n(source + first, numSamples - first, ring);
+    }
+
+    SampleType* data{ nullptr };
+    size_t numChannels{ 0 }, length{ 0 }, writePosition{ 0 };
+};
@@ -0,0 +1,793 @@
+/*
+  ==============================================================================
+
+    MultiBandCompressor.h
+    Crossover, per band compressors and band summing for N bands.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Params.h"
+#include "BandWorkerPool.h"
+#include "CompressorBand.h"
+#include "LinearPhaseCrossover.h"
+#include "LinkwitzRileyCrossover.h"
+#include "StageProfiler.h"
+
+/*
+* The band count is fixed at compile time, so the crossover's split tree and
+* allpass compensation, the band buffers and the parameter layout are all
+* sized from NumBands and nothing on the audio thread has to loop over a
+* runtime count or allocate.
+*
+* Only bands that can be heard are compressed. A muted band (or one left out
+* by a solo) fades out and then skips its compressor; a bypassed band skips
+* it too (see CompressorBand). The crossover keeps running for every band, so
+* the filter state is always warm and bands come back without a transient.
+* When every band is bypassed and audible nothing would change the signal
+* except the crossover's allpass, so the engine fades over to the untouched
+* input and skips the crossover as well.
+*
+* Oversampling is picked with the Oversampling parameter and takes effect in
+* prepare(). Only bands that can alias are oversampled: a band whose upper
+* crossover can't go above an eighth of the sample rate compresses at the
+* host rate, which in the three band build is all but the high band. Of the
+* rest, only bands that are compressing run through the oversampler. Every
+* other band is just delayed by the same amount (see CompressorBand).
+* The passthrough shortcut is off while there is latency, since the dry input
+* wouldn't line up with the processed signal.
+*
+* Lookahead is per band, but every band is delayed by the longest one so they
+* still sum in time; a band with less lookahead just delays its detector by
+* the difference. The delay lines of all the bands are slices of one arena,
+* sized for Params::MaxLookaheadMs and handed out in prepare(), so a band's
+* lookahead changes in update() by moving the delay taps. The latency moves
+* with the longest lookahead; getLatencySamples() works it out from the
+* parameters for the caller to report.
+*
+* Crossover Mode picks between the Linkwitz-Riley crossover and a linear
+* phase one (see LinearPhaseCrossover), which keeps transients intact across
+* the splits at the cost of its kernel's latency, added to the rest. Like
+* oversampling, the mode takes effect in prepare().
+*
+* Any layout up to maxChannels runs through the one engine. The crossover
+* keeps every channel of a split in neighbouring SIMD lanes, so wider layouts
+* fill its registers rather than adding passes, and each band's Link setting
+* picks independent, linked or grouped detection (see ChannelGroups).
+*
+* With Stereo Mode on Mid/Side and a stereo layout, the engine works on mid
+* and side rather than left and right. The caller encodes the block on its
+* way in, in the same pass as its input gain (see isMidSide()), every band
+* compresses mid and side on their own, the side against its own threshold,
+* and sumBands() decodes back to left and right as it adds the bands up, so
+* the matrix costs no passes of its own. The mode takes effect in prepare().
+*
+* A sidechain passed to process() is split by the same crossover, sharing
+* its coefficients (or kernels), and every band with External Key on
+* compresses on its band of the key instead of its own signal. The key is
+* only split while some band listens to it.
+*
+* The engine runs in float or double. The double one is for hosts that render
+* in 64 bit, and keeps the low crossovers accurate at high sample rates,
+* where a 20 Hz split's coefficients run out of float precision. Parameters
+* and meters are float in both.
+*
+* Once the block is split the bands are independent, so with Parallel Bands
+* on, or while the host renders offline, they are compressed on a pool of
+* worker threads (see BandWorkerPool) shared with the calling thread. Blocks
+* shorter than minParallelBlockSize stay on the calling thread, where waking
+* the workers would cost more than it saves.
+*
+* After a long enough silence the caller can put the engine to sleep (see
+* sleep()) and stop calling process() until something comes in. It wakes up
+* the same way it comes back from a bypass: the crossover and the bands start
+* again from silence.
+*
+* With a StageProfiler set, the crossover, every band and the summing are
+* timed into it; the bands are timed on whichever thread runs them.
+*/
+template <typename SampleType, size_t NumBands>
+class MultiBandCompressor {
+public:
+    static_assert(NumBands >= 2 && NumBands <= 8, "MultiBandCompressor supports 2 to 8 bands");
+
+    using Crossover = LinkwitzRileyCrossover<SampleType, NumBands>;
+    using LinearPhase = LinearPhaseCrossover<SampleType, NumBands>;
+    using BandBlocks = typename Crossover::BandBlocks;
+    using Profiler = StageProfiler<NumBands>;
+
+    static constexpr size_t numBands = NumBands;
+    static constexpr size_t numSplits = Crossover::numSplits;
+
+    // Adds the crossover and per band parameters. Bands are grouped by
+    // setting, in the order the three band layout always used.
+    static void addParameters(juce::AudioProcessorValueTreeState::ParameterLayout& Layout) {
+        using namespace juce;
+        using namespace Params;
+
+        auto bandParams = [&Layout](Names name, auto makeParam) {
+            for (size_t band{ 0 }; band < numBands; band++) {
+                const auto id = BandParamID(name, band, numBands);
+                Layout.add(makeParam(id));
+            }
+        };
+
+        auto floatParam = [](NormalisableRange<float> range, float defaultValue) {
+            return [range, defaultValue](const String& id) {
+                return std::make_unique<AudioParameterFloat>(id, id, range, defaultValue);
+            };
+        };
+
+        auto boolParam = [](const String& id) {
+            return std::make_unique<AudioParameterBool>(id, id, false);
+        };
+
+        auto AttackReleaseRange = NormalisableRange<float>(5, 500, 1, 1);
+
+        bandParams(Threshold, floatParam(NormalisableRange<float>(-60, 12, 1, 1), 0));
+        bandParams(Bypassed, boolParam);
+        bandParams(Mute, boolParam);
+        bandParams(Solo, boolParam);
+        bandParams(Attack, floatParam(AttackReleaseRange, 50));
+        bandParams(Release, floatParam(AttackReleaseRange, 250));
+
+        StringArray sa;
+        for (auto choice : RatioChoices)
+            sa.add(juce::String(choice, 1));
+
+        bandParams(Ratio, [&sa](const String& id) {
+            return std::make_unique<AudioParameterChoice>(id, id, sa, 3);
+        });
+
+        // added with the in-house compressor, and appended so the parameters
+        // that were already there keep their place
+        bandParams(Knee, floatParam(NormalisableRange<float>(0, 24, 0.5f, 1), 0));
+
+        StringArray linkChoices;
+        for (auto choice : LinkChoices)
+            linkChoices.add(choice);
+
+        bandParams(Link, [&linkChoices](const String& id) {
+            return std::make_unique<AudioParameterChoice>(id, id, linkChoices, 0);
+        });
+        bandParams(Lookahead, floatParam(NormalisableRange<float>(0, MaxLookaheadMs, 0.1f, 1), 0));
+        bandParams(ExternalKey, boolParam);
+
+        for (size_t split{ 0 }; split < numSplits; split++) {
+            const auto id = CrossoverParamID(split, numBands);
+            Layout.add(std::make_unique<AudioParameterFloat>(id, id,
+                crossoverRange(split), defaultCrossoverFrequency(split)));
+        }
+
+        StringArray oversamplingChoices;
+        for (auto choice : OversamplingChoices)
+            oversamplingChoices.add(choice);
+
+        Layout.add(std::make_unique<AudioParameterChoice>(Params::Oversampling, Params::Oversampling, oversamplingChoices, 0));
+        Layout.add(std::make_unique<AudioParameterBool>(Params::ParallelBands, Params::ParallelBands, false));
+
+        StringArray crossoverModeChoices;
+        for (auto choice : CrossoverModeChoices)
+            crossoverModeChoices.add(choice);
+
+        Layout.add(std::make_unique<AudioParameterChoice>(Params::CrossoverMode, Params::CrossoverMode, crossoverModeChoices, 0));
+
+        StringArray stereoModeChoices;
+        for (auto choice : StereoModeChoices)
+            stereoModeChoices.add(choice);
+
+        Layout.add(std::make_unique<AudioParameterChoice>(Params::StereoMode, Params::StereoMode, stereoModeChoices, 0));
+        bandParams(SideThreshold, floatParam(NormalisableRange<float>(-60, 12, 1, 1), 0));
+    }
+
+    void attach(juce::AudioProcessorValueTreeState& apvts) {
+        for (size_t split{ 0 }; split < numSplits; split++) {
+            crossoverFrequencies[split] = apvts.getRawParameterValue(Params::CrossoverParamID(split, numBands));
+            jassert(crossoverFrequencies[split]);
+        }
+
+        oversamplingOrder = apvts.getRawParameterValue(Params::Oversampling);
+        jassert(oversamplingOrder);
+        parallelBands = apvts.getRawParameterValue(Params::ParallelBands);
+        jassert(parallelBands);
+        crossoverMode = apvts.getRawParameterValue(Params::CrossoverMode);
+        jassert(crossoverMode);
+        stereoMode = apvts.getRawParameterValue(Params::StereoMode);
+        jassert(stereoMode);
+
+        for (size_t i{ 0 }; i < compressors.size(); i++)
+            compressors[i].Attach(apvts, i, numBands);
+    }
+
+    // Mute, solo and passthrough changes fade over this long.
+    static constexpr double fadeSeconds = 0.02;
+
+    static constexpr size_t minParallelBlockSize = 512;
+
+    // A Linkwitz-Riley split has rung down by 120 dB after about this many
+    // periods of its frequency.
+    static constexpr float crossoverRingingCycles = 4.f;
+
+    // A band that ends below this fraction of the sample rate isn't
+    // oversampled (see canAlias()).
+    static constexpr double aliasFreeFraction = 0.125;
+
+    // Gain reduction below this counts as released (see isSettled()).
+    static constexpr float settledGainReductionDb = 0.01f;
+
+    // Whether prepare() started the worker pool for the bands.
+    bool isParallel() const noexcept { return workers != nullptr; }
+
+    // Up to 9.1.6, or third order ambisonics.
+    static constexpr size_t maxChannels = 16;
+
+    // The profiler has to outlive the engine, or be set back to nullptr.
+    void setProfiler(Profiler* newProfiler) noexcept { profiler = newProfiler; }
+
+    // A group index per channel for grouped linking (see ChannelGroups).
+    // Message thread, before prepare().
+    void setChannelGroups(const std::vector<size_t>& groups) {
+        for (auto& compressor : compressors)
+            compressor.SetChannelGroups(groups);
+    }
+
+    // isNonRealtime turns the worker threads on whatever Parallel Bands says,
+    // so a bounce uses the idle cores. numKeyChannels is the sidechain's
+    // width, 0 without one.
+    void prepare(juce::dsp::ProcessSpec& spec, bool isNonRealtime = false, size_t numKeyChannels = 0) {
+        sampleRate = spec.sampleRate;
+        linearPhase = crossoverMode->load() > 0.5f;
+
+        // start from the current crossover settings instead of sweeping to them
+        updateCrossoverFrequencies();
+        if (linearPhase) {
+            linearPhaseCrossover.prepare(spec, numKeyChannels);
+        }
+        else {
+            linearPhaseCrossover.release();
+            crossover.prepare(spec, numKeyChannels);
+        }
+        crossoverIsStale = false;
+        keyIsStale = true;
+
+        // the band buffers hold maxChannels from the start, so a wider layout
+        // only changes how many of them are used
+        jassert(spec.numChannels <= maxChannels);
+        preparedChannels = juce::jmin(static_cast<size_t>(spec.numChannels), maxChannels);
+        midSide = stereoMode->load() > 0.5f && preparedChannels == 2;
+        for (auto& compressor : compressors)
+            compressor.SetMidSide(midSide);
+
+        for (auto& fb : FilterBuffer)
+            fb.setSize(static_cast<int>(maxChannels), static_cast<int>(spec.maximumBlockSize), false, false, true);
+        for (auto& kb : KeyBuffer)
+            kb.setSize(static_cast<int>(numKeyChannels), static_cast<int>(spec.maximumBlockSize));
+        dryBuffer.setSize(static_cast<int>(maxChannels), static_cast<int>(spec.maximumBlockSize), false, false, true);
+
+        const auto order = static_cast<size_t>(juce::jlimit(0, static_cast<int>(Params::OversamplingChoices.size()) - 1,
+                                                            static_cast<int>(oversamplingOrder->load())));
+        prepareLookahead(spec, order);
+
+        // and from the current mute/solo/bypass state
+        updateActivity();
+        for (auto& level : bandLevels)
+            level.reset(sampleRate, fadeSeconds);
+        processedMix.reset(sampleRate, fadeSeconds);
+
+        prepareWorkers(isNonRealtime || parallelBands->load() > 0.5f, spec);
+    }
+
+    // Lets go of the worker threads and the larger buffers while the engine
+    // isn't in use, e.g. the float one while the host renders in double.
+    // prepare() has to be called again before process().
+    void release() {
+        workers.reset();
+        linearPhaseCrossover.release();
+
+        for (auto& fb : FilterBuffer)
+            fb.setSize(0, 0);
+        for (auto& kb : KeyBuffer)
+            kb.setSize(0, 0);
+        dryBuffer.setSize(0, 0);
+
+        lookaheadArena.clear();
+        lookaheadArena.shrink_to_fit();
+    }
+
+    // Message thread, after a crossover moved: hands the linear phase
+    // crossover the new frequencies and wakes its designer, which sleeps
+    // otherwise. update() sets the same frequencies from the audio thread,
+    // but can't wake anyone.
+    void designCrossovers() {
+        if (!linearPhase)
+            return;
+
+        auto lower = 0.f;
+        for (size_t split{ 0 }; split < numSplits; split++) {
+            const auto frequency = limitCrossoverFrequency(split, lower);
+            linearPhaseCrossover.setCrossoverFrequency(split, frequency);
+            lower = frequency;
+        }
+
+        linearPhaseCrossover.requestDesign();
+    }
+
+    // Message thread: adds the coefficients of the crossover settings to the
+    // shared cache ahead of the audio thread, which only looks them up. The
+    // linear phase crossover has its kernels designed instead.
+    void cacheCrossoverCoefficients() {
+        if (linearPhase)
+            return;
+
+        auto lower = 0.f;
+        for (size_t split{ 0 }; split < numSplits; split++) {
+            const auto frequency = limitCrossoverFrequency(split, lower);
+            crossover.cacheCoefficients(frequency);
+            lower = frequency;
+        }
+    }
+
+    // Picks up the parameter values, before every block.
+    void update() {
+        updateCrossoverFrequencies();
+        updateLookahead();
+
+        for (auto& compressor : compressors)
+            compressor.UpdateCompressorSettings();
+
+        updateActivity();
+    }
+
+    // How long the output carries on after the input stops: the latency plus
+    // the crossover's ringing, which is longest at the lowest split.
+    size_t getTailSamples() const noexcept {
+        const auto latency = static_cast<size_t>(getLatencySamples());
+        if (linearPhase)
+            return latency + linearPhaseCrossover.getRingingSamples();
+
+        const auto lowest = juce::jmax(crossoverRange(0).start, crossoverFrequencies[0] != nullptr ? crossoverFrequencies[0]->load() : 0.f);
+        return latency + static_cast<size_t>(std::ceil(sampleRate * static_cast<double>(crossoverRingingCycles / lowest)));
+    }
+
+    // Every band has released its gain reduction, so starting them again from
+    // none (as sleep() does) sounds no different from carrying on.
+    bool isSettled() const noexcept {
+        for (auto& compressor : compressors)
+            if (compressor.GetGainReductionDb() > settledGainReductionDb)
+                return false;
+
+        return true;
+    }
+
+    // For a caller that has seen silence for getTailSamples() and will stop
+    // calling process() for now. The crossover, the key's split and every
+    // band go stale and start from silence when process() is next called.
+    void sleep() {
+        crossoverIsStale = true;
+        keyIsStale = true;
+
+        for (auto& compressor : compressors)
+            compressor.Suspend();
+    }
+
+    // Every band is bypassed and the fade to the dry input has finished, so
+    // process() would leave the block alone.
+    bool isPassthrough() const noexcept {
+        return !processedMix.isSmoothing() && processedMix.getTargetValue() == 0.f;
+    }
+
+    // Whether process() expects the block as mid and side, channels 0 and 1,
+    // and hands it back as left and right. The caller encodes with
+    // mid = (left + right) / 2 and side = (left - right) / 2. False while
+    // the engine is passed through, so the block is left alone either way.
+    bool isMidSide() const noexcept { return midSide && !isPassthrough(); }
+
+    // Splits, compresses and sums the block back in place. The block can't
+    // be longer than the maximumBlockSize given to prepare(). The key, if
+    // any, is the sidechain for the same samples.
+    void process(const juce::dsp::AudioBlock<SampleType>& block,
+                 const juce::dsp::AudioBlock<const SampleType>& key = {}) {
+        if (isPassthrough()) {
+            crossoverIsStale = true;
+            keyIsStale = true;
+            return;
+        }
+
+        // the filters stopped with the signal; starting them from silence
+        // is hidden under the fade back in
+        if (crossoverIsStale) {
+            if (linearPhase)
+                linearPhaseCrossover.reset();
+            else
+                crossover.reset();
+            crossoverIsStale = false;
+        }
+
+        if (!processedMix.isSmoothing()) {
+            splitBands(block, key);
+            compressBands();
+            sumBands(block);
+            return;
+        }
+
+        const auto numChannels = juce::jmin(block.getNumChannels(), preparedChannels);
+        const auto numSamples = block.getNumSamples();
+        auto dry = juce::dsp::AudioBlock<SampleType>(dryBuffer).getSubsetChannelBlock(0, numChannels).getSubBlock(0, numSamples);
+        dry.copyFrom(block);
+
+        splitBands(block, key);
+        compressBands();
+        sumBands(block);
+
+        // the wet side is decoded by now, so a mid/side dry copy is decoded
+        // on the way into the mix
+        if (midSide) {
+            auto* mid = dry.getChannelPointer(0);
+            auto* side = dry.getChannelPointer(1);
+            auto* left = block.getChannelPointer(0);
+            auto* right = block.getChannelPointer(1);
+
+            for (size_t i{ 0 }; i < numSamples; ++i) {
+                const auto mix = static_cast<SampleType>(processedMix.getNextValue());
+                const auto dryLeft = mid[i] + side[i];
+                const auto dryRight = mid[i] - side[i];
+                left[i] = dryLeft + (left[i] - dryLeft) * mix;
+                right[i] = dryRight + (right[i] - dryRight) * mix;
+            }
+
+            return;
+        }
+
+        for (size_t i{ 0 }; i < numSamples; ++i) {
+            const auto mix = processedMix.getNextValue();
+            for (size_t ch{ 0 }; ch < numChannels; ++ch) {
+                const auto d = dry.getChannelPointer(ch)[i];
+                auto& wet = block.getChannelPointer(ch)[i];
+                wet = d + (wet - d) * mix;
+            }
+        }
+    }
+
+    // The stages of process(), public so the benchmark can time them on
+    // their own. They have to be called in this order.
+    void splitBands(const juce::dsp::AudioBlock<SampleType>& block,
+                    const juce::dsp::AudioBlock<const SampleType>& key = {}) {
+        const typename Profiler::ScopedStage timing(profiler, Profiler::crossover);
+        const auto channels = juce::jmin(block.getNumChannels(), preparedChannels);
+        const auto numSamples = block.getNumSamples();
+        jassert(numSamples <= static_cast<size_t>(FilterBuffer[0].getNumSamples()));
+
+        for (size_t i{ 0 }; i < bands.size(); i++)
+            bands[i] = juce::dsp::AudioBlock<SampleType>(FilterBuffer[i]).getSubsetChannelBlock(0, channels).getSubBlock(0, numSamples);
+
+        const auto numKeyChannels = juce::jmin(key.getNumChannels(), static_cast<size_t>(KeyBuffer[0].getNumChannels()));
+        isKeyed = keyIsUsed && numKeyChannels > 0;
+
+        // every band comes out of a single pass over the input, straight
+        // into the preallocated band buffers
+        if (!isKeyed) {
+            keyIsStale = true;
+
+            if (linearPhase)
+                linearPhaseCrossover.process(block, bands);
+            else
+                crossover.process(block, bands);
+
+            return;
+        }
+
+        for (size_t i{ 0 }; i < keyBands.size(); i++)
+            keyBands[i] = juce::dsp::AudioBlock<SampleType>(KeyBuffer[i]).getSubsetChannelBlock(0, numKeyChannels).getSubBlock(0, numSamples);
+
+        const auto keyInput = key.getSubsetChannelBlock(0, numKeyChannels);
+
+        // a key that wasn't being split starts again from silence
+        if (keyIsStale) {
+            if (linearPhase)
+                linearPhaseCrossover.resetKey();
+            else
+                crossover.resetKey();
+            keyIsStale = false;
+        }
+
+        if (linearPhase)
+            linearPhaseCrossover.process(block, bands, keyInput, keyBands);
+        else
+            crossover.process(block, bands, keyInput, keyBands);
+    }
+
+    void compressBands() {
+        if (workers != nullptr && bands[0].getNumSamples() >= minParallelBlockSize) {
+            auto job = [this](size_t band) { compressBand(band); };
+            workers->run(numBands, job);
+            return;
+        }
+
+        for (size_t i{ 0 }; i < bands.size(); i++)
+            compressBand(i);
+    }
+
+    void sumBands(const juce::dsp::AudioBlock<SampleType>& output) {
+        const typename Profiler::ScopedStage timing(profiler, Profiler::summing);
+        std::array<const juce::dsp::AudioBlock<SampleType>*, numBands> audible{};
+        size_t numAudible{ 0 };
+
+        for (size_t i{ 0 }; i < bands.size(); i++) {
+            auto& level = bandLevels[i];
+            if (isSilent(level))
+                continue;
+
+            if (level.isSmoothing())
+                applyFade(bands[i], level);
+
+            audible[numAudible++] = &bands[i];
+        }
+
+        if (midSide && bands[0].getNumChannels() == 2) {
+            sumMidSide(output, audible, numAudible);
+            return;
+        }
+
+        // the first audible band (or the first two) overwrite the output, so
+        // there is no separate clear pass
+        const auto numSamples = static_cast<int>(output.getNumSamples());
+        for (size_t ch{ 0 }; ch < bands[0].getNumChannels(); ++ch) {
+            auto* dest = output.getChannelPointer(ch);
+
+            if (numAudible == 0) {
+                juce::FloatVectorOperations::clear(dest, numSamples);
+                continue;
+            }
+
+            if (numAudible == 1) {
+                juce::FloatVectorOperations::copy(dest, audible[0]->getChannelPointer(ch), numSamples);
+                continue;
+            }
+
+            juce::FloatVectorOperations::add(dest, audible[0]->getChannelPointer(ch), audible[1]->getChannelPointer(ch), numSamples);
+            for (size_t i{ 2 }; i < numAudible; i++)
+                juce::FloatVectorOperations::add(dest, audible[i]->getChannelPointer(ch), numSamples);
+        }
+    }
+
+    const CompressorBand<SampleType>& getBand(size_t band) const { return compressors[band]; }
+
+    // Metering rides along the compressors' gain pass, but still costs a
+    // little per sample, so it only runs while something reads the meters.
+    void setMeteringEnabled(bool shouldMeter) noexcept {
+        for (auto& compressor : compressors)
+            compressor.Meter.setActive(shouldMeter);
+    }
+
+    BandMeter& getMeter(size_t band) noexcept { return compressors[band].Meter; }
+
+    // The bands' latency, the same for every band: the oversampling's, set
+    // by prepare(), and the longest lookahead. Plus the linear phase
+    // crossover's when it is in use. The lookahead is read from the
+    // parameters, so any thread can ask, and the audio thread catches up at
+    // its next update().
+    int getLatencySamples() const noexcept {
+        std::array<size_t, NumBands> lookahead{};
+        const auto crossoverLatency = linearPhase ? linearPhaseCrossover.getLatencySamples() : size_t(0);
+        return static_cast<int>(compressors[0].GetOversamplingLatency() + readLookahead(lookahead) + crossoverLatency);
+    }
+
+private:
+    static juce::NormalisableRange<float> crossoverRange(size_t split) {
+        if (numBands == 3)
+            return split == 0 ? juce::NormalisableRange<float>(20, 999, 1, 1)
+                              : juce::NormalisableRange<float>(1000, 2000, 1, 1);
+
+        auto range = juce::NormalisableRange<float>(20, 20000, 1, 1);
+        range.setSkewForCentre(1000);
+        return range;
+    }
+
+    // Three bands keep their old defaults, otherwise the splits are spread
+    // evenly on a log scale between 100 Hz and 8 kHz.
+    static float defaultCrossoverFrequency(size_t split) {
+        if (numBands == 3)
+            return split == 0 ? 400.f : 2000.f;
+
+        const auto position = static_cast<float>(split + 1) / static_cast<float>(numBands);
+        return std::round(100.f * std::pow(80.f, position));
+    }
+
+    // Whether compressing the band can fold anything back past Nyquist. Its
+    // content ends at its upper crossover, and below an eighth of the sample
+    // rate even the gain's fourth harmonic of it stays clear. Goes by the
+    // highest the crossover can be set to, since it moves without a prepare().
+    bool canAlias(size_t band) const noexcept {
+        if (band == numSplits)
+            return true;
+
+        return crossoverRange(band).end > static_cast<float>(sampleRate * aliasFreeFraction);
+    }
+
+    // Every band's delay lines are sized for the longest lookahead the
+    // parameter allows, and get their share of the arena once all of them
+    // know what they need.
+    void prepareLookahead(juce::dsp::ProcessSpec& spec, size_t order) {
+        maxLookaheadSamples = CompressorBand<SampleType>::LookaheadSamples(Params::MaxLookaheadMs, sampleRate);
+
+        size_t arenaSize{ 0 };
+        for (size_t band{ 0 }; band < numBands; band++) {
+            compressors[band].Prepare(spec, order, maxLookaheadSamples, canAlias(band));
+            arenaSize += compressors[band].GetLookaheadStorageSize();
+        }
+
+        lookaheadArena.assign(arenaSize, SampleType(0));
+
+        auto* storage = lookaheadArena.data();
+        for (auto& compressor : compressors) {
+            compressor.SetLookaheadStorage(storage);
+            storage += compressor.GetLookaheadStorageSize();
+        }
+
+        updateLookahead();
+    }
+
+    // The longest lookahead sets every band's audio delay, and with it the
+    // latency.
+    void updateLookahead() {
+        std::array<size_t, NumBands> lookahead{};
+        const auto maxLookahead = readLookahead(lookahead);
+
+        for (size_t i{ 0 }; i < compressors.size(); i++)
+            compressors[i].SetLookahead(lookahead[i], maxLookahead);
+    }
+
+    // Each band's lookahead in samples, and the longest of them.
+    size_t readLookahead(std::array<size_t, NumBands>& lookahead) const noexcept {
+        size_t maxLookahead{ 0 };
+
+        for (size_t i{ 0 }; i < compressors.size(); i++) {
+            lookahead[i] = juce::jmin(compressors[i].GetLookaheadSamples(sampleRate), maxLookaheadSamples);
+            maxLookahead = juce::jmax(maxLookahead, lookahead[i]);
+        }
+
+        return maxLookahead;
+    }
+
+    // The bands' mid and side are added up and decoded to left and right in
+    // the same loop, so the decode is not a pass of its own.
+    void sumMidSide(const juce::dsp::AudioBlock<SampleType>& output,
+                    const std::array<const juce::dsp::AudioBlock<SampleType>*, numBands>& audible, size_t numAudible) {
+        auto* left = output.getChannelPointer(0);
+        auto* right = output.getChannelPointer(1);
+
+        for (size_t i{ 0 }; i < output.getNumSamples(); ++i) {
+            SampleType mid{ 0 }, side{ 0 };
+            for (size_t b{ 0 }; b < numAudible; ++b) {
+                mid += audible[b]->getChannelPointer(0)[i];
+                side += audible[b]->getChannelPointer(1)[i];
+            }
+
+            left[i] = mid + side;
+            right[i] = mid - side;
+        }
+    }
+
+    void compressBand(size_t band) {
+        const typename Profiler::ScopedStage timing(profiler, Profiler::bandStage(band));
+
+        if (isSilent(bandLevels[band])) {
+            compressors[band].Suspend();
+            return;
+        }
+
+        if (!isKeyed) {
+            compressors[band].Process(bands[band]);
+            return;
+        }
+
+        const juce::dsp::AudioBlock<const SampleType> key(keyBands[band]);
+        compressors[band].Process(bands[band], &key);
+    }
+
+    // One worker per band beyond the first, which the calling thread takes,
+    // and no more than there are spare cores. The workers are real-time
+    // threads woken once per host block. The pool is kept if it already has
+    // the right size and period.
+    void prepareWorkers(bool shouldUseWorkers, const juce::dsp::ProcessSpec& spec) {
+        const auto numSpareCores = static_cast<size_t>(juce::jmax(0, juce::SystemStats::getNumCpus() - 1));
+        const auto numWorkers = shouldUseWorkers ? juce::jmin(numBands - 1, numSpareCores) : size_t(0);
+        const auto blocksPerSecond = spec.sampleRate / static_cast<double>(juce::jmax(1u, spec.maximumBlockSize));
+
+        if (numWorkers == 0)
+            workers.reset();
+        else if (workers == nullptr || workers->getNumWorkers() != numWorkers || workers->getPeriodHz() != blocksPerSecond)
+            workers = std::make_unique<BandWorkerPool>(numWorkers, blocksPerSecond);
+    }
+
+    static bool isSilent(const juce::SmoothedValue<float>& level) noexcept {
+        return !level.isSmoothing() && level.getTargetValue() == 0.f;
+    }
+
+    static void applyFade(const juce::dsp::AudioBlock<SampleType>& block, juce::SmoothedValue<float>& level) {
+        for (size_t i{ 0 }; i < block.getNumSamples(); ++i) {
+            const auto gain = level.getNextValue();
+            for (size_t ch{ 0 }; ch < block.getNumChannels(); ++ch)
+                block.getChannelPointer(ch)[i] *= gain;
+        }
+    }
+
+    // Works out which bands can be heard and whether the whole engine can
+    // step aside. A soloed band silences every band that isn't soloed.
+    //
+    // Once passed through, the caller may stop calling process() altogether
+    // (the processor does with unity gains), so the filters are marked stale
+    // here rather than only there; whatever they held when they stopped could
+    // be minutes old by the time a band comes back.
+    void updateActivity() {
+        if (isPassthrough()) {
+            crossoverIsStale = true;
+            keyIsStale = true;
+        }
+
+        auto bandIsSoloed = false;
+        for (auto& comp : compressors) {
+            if (comp.IsSoloed()) {
+                bandIsSoloed = true;
+                break;
+            }
+        }
+
+        auto isNeutral = true;
+        keyIsUsed = false;
+        for (size_t i{ 0 }; i < compressors.size(); i++) {
+            auto& comp = compressors[i];
+            const auto isAudible = bandIsSoloed ? comp.IsSoloed() : !comp.IsMuted();
+
+            bandLevels[i].setTargetValue(isAudible ? 1.f : 0.f);
+            isNeutral = isNeutral && isAudible && comp.IsBypassed();
+            keyIsUsed = keyIsUsed || (isAudible && comp.IsKeyedExternally() && !comp.IsFullyBypassed());
+        }
+
+        processedMix.setTargetValue(isNeutral && getLatencySamples() == 0 ? 0.f : 1.f);
+    }
+
+    // Crossovers that overlap would fold bands into each other, so each split
+    // is held at or above the one below it, and below Nyquist.
+    void updateCrossoverFrequencies() {
+        auto lower = 0.f;
+
+        for (size_t split{ 0 }; split < numSplits; split++) {
+            const auto frequency = limitCrossoverFrequency(split, lower);
+            if (linearPhase)
+                linearPhaseCrossover.setCrossoverFrequency(split, frequency);
+            else
+                crossover.setCrossoverFrequency(split, frequency);
+            lower = frequency;
+        }
+    }
+
+    float limitCrossoverFrequency(size_t split, float lower) const noexcept {
+        const auto maxFrequency = static_cast<float>(sampleRate * 0.45);
+        return juce::jlimit(lower, maxFrequency, crossoverFrequencies[split]->load());
+    }
+
+    Crossover crossover;
+    LinearPhase linearPhaseCrossover;
+    bool linearPhase{ false }, midSide{ false };
+    std::array<CompressorBand<SampleType>, NumBands> compressors;
+    std::array<juce::AudioBuffer<SampleType>, NumBands> FilterBuffer, KeyBuffer;
+    BandBlocks bands, keyBands;
+    juce::AudioBuffer<SampleType> dryBuffer;
+    std::array<juce::SmoothedValue<float>, NumBands> bandLevels;
+    juce::SmoothedValue<float> processedMix{ 1.f };
+    bool crossoverIsStale{ false }, keyIsStale{ true }, keyIsUsed{ false }, isKeyed{ false };
+    std::array<std::atomic<float>*, numSplits> crossoverFrequencies{};
+    std::atomic<float>* oversamplingOrder{ nullptr };
+    std::atomic<float>* parallelBands{ nullptr };
+    std::atomic<float>* crossoverMode{ nullptr };
+    std::atomic<float>* stereoMode{ nullptr };
+    std::unique_ptr<BandWorkerPool> workers;
+    std::vector<SampleType> lookaheadArena;
+    Profiler* profiler{ nullptr };
+    size_t preparedChannels{ 0 }, maxLookaheadSamples{ 0 };
+    double sampleRate{ 44100.0 };
+};
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    SampleFifo.h
+    Lock-free mono sample queue from the audio thread to an analyser.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* Single producer, single consumer, built on juce::AbstractFifo so neither
+* side takes a lock. The audio thread averages its channels into the queue and
+* drops whatever doesn't fit rather than wait, so a reader that falls behind
+* only loses samples. The storage is allocated once, up front.
+*
+* Like the meters, it only takes samples while it is switched on.
+*/
+class SampleFifo {
+public:
+    explicit SampleFifo(int capacity = 1 << 15)
+        : fifo(capacity), samples(static_cast<size_t>(capacity)) {}
+
+    void setActive(bool shouldBeActive) noexcept { active.store(shouldBeActive, std::memory_order_relaxed); }
+    bool isActive() const noexcept { return active.load(std::memory_order_relaxed); }
+
+    // audio thread; a double block is narrowed to float on the way in
+    template <typename SampleType>
+    void push(const juce::dsp::AudioBlock<SampleType>& block) noexcept {
+        if (!isActive() || block.getNumChannels() == 0)
+            return;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(static_cast<int>(block.getNumSamples()), start1, size1, start2, size2);
+
+        downmix(block, 0, start1, size1);
+        downmix(block, static_cast<size_t>(size1), start2, size2);
+
+        fifo.finishedWrite(size1 + size2);
+    }
+
+    // analyser thread; returns the number of samples copied
+    int pull(float* dest, int maxSamples) noexcept {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(maxSamples, start1, size1, start2, size2);
+
+        std::copy_n(samples.data() + start1, size1, dest);
+        std::copy_n(samples.data() + start2, size2, dest + size1);
+
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+    // analyser thread: throws away anything queued before it started reading
+    void discard() noexcept { fifo.finishedRead(fifo.getNumReady()); }
+
+private:
+    template <typename SampleType>
+    void downmix(const juce::dsp::AudioBlock<SampleType>& block, size_t offset, int start, int size) noexcept {
+        if (size <= 0)
+            return;
+
+        auto* dest = samples.data() + start;
+
+        if constexpr (std::is_same_v<std::remove_const_t<SampleType>, float>) {
+            juce::FloatVectorOperations::copy(dest, block.getChannelPointer(0) + offset, size);
+
+            for (size_t ch = 1; ch < block.getNumChannels(); ++ch)
+                juce::FloatVectorOperations::add(dest, block.getChannelPointer(ch) + offset, size);
+        }
+        else {
+            std::fill_n(dest, size, 0.f);
+
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch) {
+                const auto* source = block.getChannelPointer(ch) + offset;
+                for (int i = 0; i < size; ++i)
+                    dest[i] += static_cast<float>(source[i]);
+            }
+        }
+
+        if (block.getNumChannels() > 1)
+            juce::FloatVectorOperations::multiply(dest, 1.f / static_cast<float>(block.getNumChannels()), size);
+    }
+
+    juce::AbstractFifo fifo;
+    std::vector<float> samples;
+    std::atomic<bool> active{ false };
+};
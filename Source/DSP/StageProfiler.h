@@ -0,0 +1,328 @@
+/*
+  ==============================================================================
+
+    StageProfiler.h
+    Per stage timing histograms and overload counting for processBlock.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Params.h"
+
+#ifndef MBC_PROFILING
+ #define MBC_PROFILING 1
+#endif
+
+#if MBC_PROFILING && JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+/*
+* Every instance keeps one of these, so a session that starts to crackle
+* can be read instance by instance without a profiler attached.
+*
+* The stages of a block (input gain, crossover, each band, summing, output
+* gain) are timed with ScopedStage into histograms of power of two buckets.
+* The processor runs a host block in sub-blocks, so a stage can run several
+* times per block; its times are added up and go into the histogram once
+* per host block, when the ScopedBlock ends. Counts and durations then mean
+* the same whatever the sub-block size, and line up with the block loads.
+* The times are counter ticks: TSC cycles on x86, the high resolution clock
+* elsewhere. The whole block is also timed on the clock and compared with
+* the time its samples last, its budget. A block taking more than the
+* overload threshold (a fraction of the budget) counts as an overload.
+*
+* The audio thread (and a worker running a band) only adds to relaxed
+* atomics. Each stage has one writer at a time, and the worker pool orders
+* a band's writers from block to block. Readers get a Snapshot at any time.
+* A snapshot may be mid block, but every counter in it is whole.
+*
+* MBC_PROFILING=0 compiles the timing out: the scopes are empty, and the
+* snapshots and reports stay empty.
+*/
+template <size_t NumBands>
+class StageProfiler {
+public:
+    static constexpr bool isEnabled = MBC_PROFILING != 0;
+
+    enum Stage : size_t { inputGain, crossover, summing, outputGain, firstBand };
+    static constexpr size_t numStages = firstBand + NumBands;
+
+    static constexpr size_t bandStage(size_t band) noexcept { return firstBand + band; }
+
+    static juce::String getStageName(size_t stage) {
+        switch (stage) {
+            case inputGain: return "Input gain";
+            case crossover: return "Crossover";
+            case summing: return "Band summing";
+            case outputGain: return "Output gain";
+            default: return Params::BandName(stage - firstBand, NumBands);
+        }
+    }
+
+    // Bucket b holds durations of 2^(b-1) up to 2^b ticks; bucket 0 is zero.
+    static constexpr size_t numTickBuckets = 33;
+
+    // Block load in steps of loadBucketPercent of the budget; the last
+    // bucket takes everything above.
+    static constexpr size_t numLoadBuckets = 21;
+    static constexpr int loadBucketPercent = 10;
+
+    struct Histogram {
+        std::array<juce::uint64, numTickBuckets> buckets{};
+        juce::uint64 count{ 0 }, total{ 0 }, max{ 0 };
+
+        double getMean() const noexcept { return count > 0 ? static_cast<double>(total) / static_cast<double>(count) : 0.0; }
+
+        // The upper edge of the bucket the fraction of the counts falls in.
+        juce::uint64 getPercentile(double fraction) const noexcept {
+            const auto target = static_cast<juce::uint64>(std::ceil(fraction * static_cast<double>(count)));
+            juce::uint64 seen{ 0 };
+
+            for (size_t b{ 0 }; b < numTickBuckets; ++b) {
+                seen += buckets[b];
+                if (seen >= target && seen > 0)
+                    return b == 0 ? 0 : juce::uint64(1) << b;
+            }
+
+            return max;
+        }
+    };
+
+    struct Snapshot {
+        std::array<Histogram, numStages> stages;
+        std::array<juce::uint64, numLoadBuckets> loadBuckets{};
+        juce::uint64 numBlocks{ 0 }, numOverloads{ 0 };
+        double totalLoad{ 0 }, peakLoad{ 0 }; // as fractions of the budget
+    };
+
+    //==============================================================================
+    // audio thread (and the band workers)
+
+    class ScopedStage {
+    public:
+#if MBC_PROFILING
+        ScopedStage(StageProfiler* p, size_t s) noexcept : profiler(p), stage(s), start(p != nullptr ? readTicks() : 0) {}
+
+        ~ScopedStage() {
+            if (profiler != nullptr)
+                profiler->accumulate(stage, readTicks() - start);
+        }
+
+    private:
+        StageProfiler* profiler;
+        size_t stage;
+        juce::uint64 start;
+#else
+        ScopedStage(StageProfiler*, size_t) noexcept {}
+#endif
+        JUCE_DECLARE_NON_COPYABLE(ScopedStage)
+    };
+
+    // Times a whole processBlock against the time its samples last.
+    class ScopedBlock {
+    public:
+#if MBC_PROFILING
+        ScopedBlock(StageProfiler& p, size_t n, double rate) noexcept
+            : profiler(p), numSamples(n), sampleRate(rate), start(juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedBlock() {
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            profiler.recordBlock(elapsed, numSamples, sampleRate);
+        }
+
+    private:
+        StageProfiler& profiler;
+        size_t numSamples;
+        double sampleRate;
+        juce::int64 start;
+#else
+        ScopedBlock(StageProfiler&, size_t, double) noexcept {}
+#endif
+        JUCE_DECLARE_NON_COPYABLE(ScopedBlock)
+    };
+
+    //==============================================================================
+    // any thread
+
+    // A block over this fraction of its budget is an overload.
+    void setOverloadThreshold(float fractionOfBudget) noexcept { overloadThreshold.store(juce::jmax(0.01f, fractionOfBudget)); }
+    float getOverloadThreshold() const noexcept { return overloadThreshold.load(); }
+
+    void read(Snapshot& dest) const noexcept {
+        for (size_t s{ 0 }; s < numStages; ++s) {
+            auto& source = stages[s];
+            auto& stage = dest.stages[s];
+
+            for (size_t b{ 0 }; b < numTickBuckets; ++b)
+                stage.buckets[b] = source.buckets[b].load(std::memory_order_relaxed);
+
+            stage.count = source.count.load(std::memory_order_relaxed);
+            stage.total = source.total.load(std::memory_order_relaxed);
+            stage.max = source.max.load(std::memory_order_relaxed);
+        }
+
+        for (size_t b{ 0 }; b < numLoadBuckets; ++b)
+            dest.loadBuckets[b] = loadBuckets[b].load(std::memory_order_relaxed);
+
+        dest.numBlocks = numBlocks.load(std::memory_order_relaxed);
+        dest.numOverloads = numOverloads.load(std::memory_order_relaxed);
+        dest.totalLoad = static_cast<double>(totalLoadPermille.load(std::memory_order_relaxed)) / 1000.0;
+        dest.peakLoad = static_cast<double>(peakLoadPermille.load(std::memory_order_relaxed)) / 1000.0;
+    }
+
+    // Message thread. A block in flight may still land in the old counts.
+    void reset() noexcept {
+        for (auto& stage : stages) {
+            for (auto& bucket : stage.buckets)
+                bucket.store(0, std::memory_order_relaxed);
+
+            stage.count.store(0, std::memory_order_relaxed);
+            stage.total.store(0, std::memory_order_relaxed);
+            stage.max.store(0, std::memory_order_relaxed);
+        }
+
+        for (size_t s{ 0 }; s < numStages; ++s) {
+            pending[s].store(0, std::memory_order_relaxed);
+            ran[s].store(false, std::memory_order_relaxed);
+        }
+
+        for (auto& bucket : loadBuckets)
+            bucket.store(0, std::memory_order_relaxed);
+
+        numBlocks.store(0, std::memory_order_relaxed);
+        numOverloads.store(0, std::memory_order_relaxed);
+        totalLoadPermille.store(0, std::memory_order_relaxed);
+        peakLoadPermille.store(0, std::memory_order_relaxed);
+    }
+
+    // A plain text table of every stage and of the block loads.
+    void writeReport(juce::OutputStream& out) const {
+        if (!isEnabled) {
+            out << "profiling is compiled out (MBC_PROFILING=0)\n";
+            return;
+        }
+
+        Snapshot snapshot;
+        read(snapshot);
+
+        out << "blocks " << juce::String(static_cast<juce::int64>(snapshot.numBlocks))
+            << ", overloads " << juce::String(static_cast<juce::int64>(snapshot.numOverloads))
+            << " (over " << juce::String(getOverloadThreshold() * 100.f, 0) << "% of the budget)"
+            << ", mean load " << juce::String(snapshot.numBlocks > 0 ? 100.0 * snapshot.totalLoad / static_cast<double>(snapshot.numBlocks) : 0.0, 1) << "%"
+            << ", peak " << juce::String(100.0 * snapshot.peakLoad, 1) << "%\n\n";
+
+        out << juce::String("stage").paddedRight(' ', 16) << juce::String("count").paddedLeft(' ', 10)
+            << juce::String("mean").paddedLeft(' ', 12) << juce::String("p50").paddedLeft(' ', 12)
+            << juce::String("p99").paddedLeft(' ', 12) << juce::String("max").paddedLeft(' ', 12) << "   (ticks)\n";
+
+        for (size_t s{ 0 }; s < numStages; ++s) {
+            const auto& stage = snapshot.stages[s];
+            auto ticks = [](juce::uint64 value) { return juce::String(static_cast<juce::int64>(value)).paddedLeft(' ', 12); };
+
+            out << getStageName(s).paddedRight(' ', 16) << juce::String(static_cast<juce::int64>(stage.count)).paddedLeft(' ', 10)
+                << juce::String(stage.getMean(), 0).paddedLeft(' ', 12) << ticks(stage.getPercentile(0.5))
+                << ticks(stage.getPercentile(0.99)) << ticks(stage.max) << "\n";
+        }
+
+        out << "\nblock load (% of budget)\n";
+        for (size_t b{ 0 }; b < numLoadBuckets; ++b) {
+            if (snapshot.loadBuckets[b] == 0)
+                continue;
+
+            const auto from = static_cast<int>(b) * loadBucketPercent;
+            const auto label = b + 1 < numLoadBuckets ? juce::String(from) + "-" + juce::String(from + loadBucketPercent)
+                                                      : juce::String(from) + "+";
+            out << label.paddedLeft(' ', 10) << juce::String(static_cast<juce::int64>(snapshot.loadBuckets[b])).paddedLeft(' ', 10) << "\n";
+        }
+    }
+
+private:
+    struct AtomicHistogram {
+        std::array<std::atomic<juce::uint64>, numTickBuckets> buckets{};
+        std::atomic<juce::uint64> count{ 0 }, total{ 0 }, max{ 0 };
+    };
+
+    // Only one thread writes a counter at a time, so a load and a store do
+    // instead of a locked read-modify-write.
+    static void add(std::atomic<juce::uint64>& counter, juce::uint64 amount) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static void raise(std::atomic<juce::uint64>& counter, juce::uint64 value) noexcept {
+        if (value > counter.load(std::memory_order_relaxed))
+            counter.store(value, std::memory_order_relaxed);
+    }
+
+#if MBC_PROFILING
+    static juce::uint64 readTicks() noexcept {
+       #if JUCE_INTEL
+        return static_cast<juce::uint64>(__rdtsc());
+       #else
+        return static_cast<juce::uint64>(juce::Time::getHighResolutionTicks());
+       #endif
+    }
+#endif
+
+    // Held until the block ends. A band worker only touches its own band's
+    // entries, and is done with them before the audio thread's ScopedBlock
+    // ends (the pool's run() waits for it).
+    void accumulate(size_t stage, juce::uint64 ticks) noexcept {
+        add(pending[stage], ticks);
+        ran[stage].store(true, std::memory_order_relaxed);
+    }
+
+    void recordStages() noexcept {
+        for (size_t s{ 0 }; s < numStages; ++s) {
+            if (!ran[s].load(std::memory_order_relaxed))
+                continue;
+
+            record(s, pending[s].load(std::memory_order_relaxed));
+            pending[s].store(0, std::memory_order_relaxed);
+            ran[s].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void record(size_t stage, juce::uint64 ticks) noexcept {
+        auto& histogram = stages[stage];
+        const auto bucket = ticks == 0 ? 0 : static_cast<size_t>(juce::findHighestSetBit(static_cast<juce::uint32>(juce::jmin(ticks, juce::uint64(0xffffffff))))) + 1;
+
+        add(histogram.buckets[bucket], 1);
+        add(histogram.count, 1);
+        add(histogram.total, ticks);
+        raise(histogram.max, ticks);
+    }
+
+    void recordBlock(double seconds, size_t numSamples, double sampleRate) noexcept {
+        recordStages();
+
+        if (numSamples == 0 || sampleRate <= 0)
+            return;
+
+        const auto load = seconds * sampleRate / static_cast<double>(numSamples);
+        const auto permille = static_cast<juce::uint64>(load * 1000.0);
+        const auto bucket = juce::jmin(numLoadBuckets - 1, static_cast<size_t>(load * 100.0) / static_cast<size_t>(loadBucketPercent));
+
+        add(loadBuckets[bucket], 1);
+        add(numBlocks, 1);
+        add(totalLoadPermille, permille);
+        raise(peakLoadPermille, permille);
+
+        if (load > static_cast<double>(overloadThreshold.load(std::memory_order_relaxed)))
+            add(numOverloads, 1);
+    }
+
+    std::array<AtomicHistogram, numStages> stages;
+    std::array<std::atomic<juce::uint64>, numStages> pending{};
+    std::array<std::atomic<bool>, numStages> ran{};
+    std::array<std::atomic<juce::uint64>, numLoadBuckets> loadBuckets{};
+    std::atomic<juce::uint64> numBlocks{ 0 }, numOverloads{ 0 }, totalLoadPermille{ 0 }, peakLoadPermille{ 0 };
+    std::atomic<float> overloadThreshold{ 0.5f };
+};
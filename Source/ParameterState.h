@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+    ParameterState.h
+    Compact binary plugin state: a versioned, fixed layout parameter blob.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Params.h"
+
+/*
+* The state is a short header followed by one little endian float per
+* parameter, in a layout fixed by the schema rather than looked up by ID:
+*
+*   uint32 magic ("MBCS")   uint16 version   uint16 band count
+*   uint32 value count      float values[value count]
+*
+* Values are stored as the parameter's real value (dB, ms, choice index),
+* not normalised, so a range that changes later still reads back the same
+* setting.
+*
+* Writing and reading go through a table of parameters built once in the
+* constructor, so saving and loading a session of many instances neither
+* parses IDs nor builds a ValueTree for every parameter. States saved before
+* this format (a ValueTree written with writeToStream()) are told apart by
+* the magic number and still load through the APVTS.
+*
+* Layouts only ever grow at the end: a new parameter goes at the end of
+* getLayout(), together with a new schemaVersion. An older state then just
+* leaves the newer parameters at their defaults, and a newer state's extra
+* values are ignored. Anything that changes what an existing value means
+* goes in migrate().
+*
+* A whole state (a loaded session, a preset, an A/B slot) is set through
+* apply(), which the audio thread takes either completely or not at all:
+* the processor reads its parameters inside readSettings(), and apply()
+* waits for such a read to finish and holds new ones off until every value
+* is written. The smoothing in the engine then glides to the new settings.
+*/
+class ParameterState {
+public:
+    // Real parameter values in layout order.
+    using Values = std::vector<float>;
+
+    static constexpr juce::uint32 magic = 0x5343424d; // "MBCS"
+    static constexpr juce::uint16 schemaVersion = 4;
+    static constexpr size_t headerSize = 12;
+
+    ParameterState(juce::AudioProcessorValueTreeState& apvts, size_t bands) : numBands(bands) {
+        for (auto& id : getLayout(numBands)) {
+            auto* parameter = apvts.getParameter(id);
+            jassert(parameter != nullptr);
+            parameters.push_back(parameter);
+        }
+
+        values.resize(parameters.size());
+    }
+
+    // The parameter IDs of the current schema, in blob order: the globals,
+    // each band setting for every band, the crossovers, then the engine
+    // settings. Anything added later goes after all of these, in the order
+    // it was added: Crossover Mode came with schema version 2, the bands'
+    // External Key with 3, Stereo Mode and the bands' Side Threshold with 4.
+    static juce::StringArray getLayout(size_t numBands) {
+        juce::StringArray ids{ Params::InputGain, Params::OutputGain };
+
+        for (auto name : { Params::Threshold, Params::Attack, Params::Release, Params::Ratio, Params::Knee,
+                           Params::Link, Params::Lookahead, Params::Bypassed, Params::Mute, Params::Solo })
+            for (size_t band{ 0 }; band < numBands; band++)
+                ids.add(Params::BandParamID(name, band, numBands));
+
+        for (size_t split{ 0 }; split + 1 < numBands; split++)
+            ids.add(Params::CrossoverParamID(split, numBands));
+
+        ids.add(Params::Oversampling);
+        ids.add(Params::ParallelBands);
+        ids.add(Params::CrossoverMode);
+
+        for (size_t band{ 0 }; band < numBands; band++)
+            ids.add(Params::BandParamID(Params::ExternalKey, band, numBands));
+
+        ids.add(Params::StereoMode);
+
+        for (size_t band{ 0 }; band < numBands; band++)
+            ids.add(Params::BandParamID(Params::SideThreshold, band, numBands));
+
+        return ids;
+    }
+
+    size_t getNumValues() const noexcept { return parameters.size(); }
+
+    static bool isBinaryState(const void* data, int sizeInBytes) noexcept {
+        return sizeInBytes >= static_cast<int>(headerSize)
+            && juce::ByteOrder::littleEndianInt(data) == magic;
+    }
+
+    //==============================================================================
+    // message thread
+
+    void capture(Values& dest) const {
+        dest.resize(parameters.size());
+
+        for (size_t i{ 0 }; i < parameters.size(); ++i)
+            dest[i] = parameters[i]->convertFrom0to1(parameters[i]->getValue());
+    }
+
+    void getDefaults(Values& dest) const {
+        dest.resize(parameters.size());
+
+        for (size_t i{ 0 }; i < parameters.size(); ++i)
+            dest[i] = parameters[i]->convertFrom0to1(parameters[i]->getDefaultValue());
+    }
+
+    // Sets every parameter that differs, as one change for the audio thread.
+    // Values missing at the end are left as they are.
+    void apply(const Values& newValues) {
+        isWriting.store(true);
+        while (isReading.load())
+            std::this_thread::yield();
+
+        for (size_t i{ 0 }; i < juce::jmin(newValues.size(), parameters.size()); ++i) {
+            auto* parameter = parameters[i];
+            const auto normalised = parameter->convertTo0to1(newValues[i]);
+
+            if (normalised != parameter->getValue())
+                parameter->setValueNotifyingHost(normalised);
+        }
+
+        isWriting.store(false);
+    }
+
+    void write(juce::MemoryBlock& dest) {
+        capture(values);
+        encode(values, numBands, dest);
+    }
+
+    // False if the data is damaged or was saved by a build with a different
+    // band count, in which case nothing changes.
+    bool read(const void* data, int sizeInBytes) {
+        getDefaults(values);
+        if (!decode(data, sizeInBytes, numBands, values))
+            return false;
+
+        apply(values);
+        return true;
+    }
+
+    //==============================================================================
+    // any thread
+
+    static void encode(const Values& source, size_t numBands, juce::MemoryBlock& dest) {
+        const auto numValues = source.size();
+        dest.setSize(headerSize + numValues * sizeof(float));
+
+        auto* bytes = static_cast<char*>(dest.getData());
+        writeLittleEndian(bytes, magic);
+        writeLittleEndian(bytes + 4, schemaVersion);
+        writeLittleEndian(bytes + 6, static_cast<juce::uint16>(numBands));
+        writeLittleEndian(bytes + 8, static_cast<juce::uint32>(numValues));
+
+        auto* valueBytes = bytes + headerSize;
+        for (auto value : source) {
+            juce::uint32 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            writeLittleEndian(valueBytes, bits);
+            valueBytes += sizeof(float);
+        }
+    }
+
+    // Overwrites the start of dest with the stored values, brought up to the
+    // current schema. Whatever dest holds past them (defaults, usually) is
+    // kept, and stored values past its size are ignored.
+    static bool decode(const void* data, int sizeInBytes, size_t numBands, Values& dest) {
+        if (!isBinaryState(data, sizeInBytes))
+            return false;
+
+        const auto* bytes = static_cast<const char*>(data);
+        const auto version = juce::ByteOrder::littleEndianShort(bytes + 4);
+        const auto bands = juce::ByteOrder::littleEndianShort(bytes + 6);
+        const auto numStored = static_cast<size_t>(juce::ByteOrder::littleEndianInt(bytes + 8));
+
+        if (bands != numBands || headerSize + numStored * sizeof(float) > static_cast<size_t>(sizeInBytes))
+            return false;
+
+        const auto* valueBytes = bytes + headerSize;
+        for (size_t i{ 0 }; i < juce::jmin(numStored, dest.size()); ++i) {
+            const auto bits = juce::ByteOrder::littleEndianInt(valueBytes + i * sizeof(float));
+            std::memcpy(&dest[i], &bits, sizeof(bits));
+        }
+
+        migrate(version, dest);
+        return true;
+    }
+
+    //==============================================================================
+    // audio thread
+
+    // Calls read() unless apply() is busy, in which case the block keeps the
+    // settings it already has and picks the new ones up on the next.
+    template <typename Fn>
+    void readSettings(Fn&& read) noexcept {
+        isReading.store(true);
+
+        if (!isWriting.load())
+            read();
+
+        isReading.store(false);
+    }
+
+private:
+    // Brings values saved by an older schema up to the current one, in place.
+    // Versions 2 to 4 only added parameters at the end, which an older
+    // state leaves at their defaults, so nothing has had to change yet.
+    static void migrate(juce::uint16 fromVersion, Values& values) {
+        juce::ignoreUnused(fromVersion, values);
+    }
+
+    template <typename IntType>
+    static void writeLittleEndian(char* dest, IntType value) noexcept {
+        value = juce::ByteOrder::swapIfBigEndian(value);
+        std::memcpy(dest, &value, sizeof(value));
+    }
+
+    size_t numBands;
+    std::vector<juce::RangedAudioParameter*> parameters;
+    Values values;
+
+    // seq_cst, so either the reader sees isWriting or apply() sees isReading
+    std::atomic<bool> isWriting{ false }, isReading{ false };
+};
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    Params.h
+    Parameter IDs for an N band build of the compressor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Params{
+    // Settings every band has. The parameter ID is the name followed by the
+    // band's name, e.g. "Threshold Low Band" or "Threshold Band 4".
+    enum Names {
+        Threshold,
+        Attack,
+        Release,
+        Ratio,
+        Knee,
+        Link,
+        Lookahead,
+        ExternalKey,
+        Bypassed,
+        Mute,
+        Solo,
+        SideThreshold,
+
+        NumBandParams
+    };
+
+    inline constexpr std::array<const char*, NumBandParams> ParamNames{
+        "Threshold",
+        "Attack",
+        "Release",
+        "Ratio",
+        "Knee",
+        "Stereo Link",
+        "Lookahead",
+        "External Key",
+        "Bypassed",
+        "Mute",
+        "Solo",
+        "Side Threshold"
+    };
+
+    inline constexpr const char* InputGain{ "Input Gain" };
+    inline constexpr const char* OutputGain{ "Output Gain" };
+    inline constexpr const char* Oversampling{ "Oversampling" };
+    inline constexpr const char* ParallelBands{ "Parallel Bands" };
+    inline constexpr const char* CrossoverMode{ "Crossover Mode" };
+    inline constexpr const char* StereoMode{ "Stereo Mode" };
+
+    // The oversampling choices; the raw value is the Oversampling order.
+    inline constexpr std::array<const char*, 4> OversamplingChoices{ "Off", "2x", "4x", "8x" };
+
+    // The crossover modes; the raw value indexes this.
+    inline constexpr std::array<const char*, 2> CrossoverModeChoices{ "Minimum Phase", "Linear Phase" };
+
+    // The stereo modes; the raw value indexes this. Mid/Side only applies to
+    // a stereo main bus.
+    inline constexpr std::array<const char*, 2> StereoModeChoices{ "Left/Right", "Mid/Side" };
+
+    // The per band Link choices; the raw value indexes this. Link used to be
+    // a switch, so off and on keep indices 0 and 1.
+    inline constexpr std::array<const char*, 3> LinkChoices{ "Independent", "Linked", "Grouped" };
+
+    // Upper end of the per band Lookahead parameter.
+    inline constexpr float MaxLookaheadMs{ 10.f };
+
+    // The ratio choices, in parameter order. The choice parameter's raw
+    // value is an index into this.
+    inline constexpr std::array<float, 14> RatioChoices{ 1.f, 1.5f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 10.f, 15.f, 20.f, 50.f, 100.f };
+
+    inline float RatioFromIndex(float index) {
+        const auto i = juce::jlimit(0, static_cast<int>(RatioChoices.size()) - 1, static_cast<int>(index));
+        return RatioChoices[static_cast<size_t>(i)];
+    }
+
+    // A three band build keeps the Low/Mid/High IDs the plugin always had, so
+    // existing sessions and presets still find their parameters. Any other
+    // band count numbers its bands and crossovers from 1, bottom up.
+    inline juce::String BandName(size_t band, size_t numBands) {
+        jassert(band < numBands);
+
+        if (numBands == 3)
+            return std::array<const char*, 3>{ "Low Band", "Mid Band", "High Band" }[band];
+
+        return "Band " + juce::String(static_cast<int>(band) + 1);
+    }
+
+    inline juce::String BandParamID(Names name, size_t band, size_t numBands) {
+        return juce::String(ParamNames[name]) + " " + BandName(band, numBands);
+    }
+
+    inline juce::String CrossoverParamID(size_t split, size_t numBands) {
+        jassert(split + 1 < numBands);
+
+        if (numBands == 3)
+            return split == 0 ? "Low Mid Crossover Freq" : "Mid High Crossover Freq";
+
+        return "Crossover " + juce::String(static_cast<int>(split) + 1) + " Freq";
+    }
+}
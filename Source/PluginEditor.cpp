@@ -1,40 +1,358 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-
-//==============================================================================
-NewProjectAudioProcessorEditor::NewProjectAudioProcessorEditor (NewProjectAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
-{
-    // Make sure that before the constructor has finished, you've set the
-    // editor's size to whatever you need it to be.
-    setSize (400, 300);
-}
-
-NewProjectAudioProcessorEditor::~NewProjectAudioProcessorEditor()
-{
-}
-
-//==============================================================================
-void NewProjectAudioProcessorEditor::paint (juce::Graphics& g)
-{
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
-
-    g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
-}
-
-void NewProjectAudioProcessorEditor::resized()
-{
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+namespace
+{
+    constexpr float meterFloorDb = -60.0f;
+    constexpr float meterCeilingDb = 6.0f;
+    constexpr float gainReductionRangeDb = 24.0f;
+
+    float meterProportion (float gain)
+    {
+        const auto db = juce::Decibels::gainToDecibels (gain, meterFloorDb);
+        return juce::jlimit (0.0f, 1.0f, (db - meterFloorDb) / (meterCeilingDb - meterFloorDb));
+    }
+}
+
+//==============================================================================
+NewProjectAudioProcessorEditor::NewProjectAudioProcessorEditor (NewProjectAudioProcessor& p)
+    : AudioProcessorEditor (&p),
+      analyser (p.getInputSpectrumFifo(), p.getOutputSpectrumFifo()),
+      audioProcessor (p)
+{
+    for (size_t split = 0; split < crossovers.size(); ++split)
+        crossovers[split] = p.apvts.getRawParameterValue (Params::CrossoverParamID (split, NewProjectAudioProcessor::NumBands));
+
+    presetBox.setTextWhenNothingSelected ("Presets");
+    presetBox.onChange = [this]
+    {
+        if (const auto id = presetBox.getSelectedId(); id > 0)
+            selectPreset (id - 1);
+    };
+    addAndMakeVisible (presetBox);
+
+    for (auto* button : { &compareA, &compareB })
+    {
+        button->setClickingTogglesState (false);
+        button->setColour (juce::TextButton::buttonOnColourId, juce::Colours::orange);
+        addAndMakeVisible (*button);
+    }
+
+    compareA.onClick = [this] { selectCompareSlot (0); };
+    compareB.onClick = [this] { selectCompareSlot (1); };
+
+    audioProcessor.getPresets().addChangeListener (this);
+    refreshPresetList();
+    selectCompareSlot (audioProcessor.getPresets().getCompareSlot());
+
+    // Make sure that before the constructor has finished, you've set the
+    // editor's size to whatever you need it to be.
+    setSize (juce::jmax (600, 120 * static_cast<int> (NewProjectAudioProcessor::NumBands)), 500);
+    updateLiveViews();
+}
+
+NewProjectAudioProcessorEditor::~NewProjectAudioProcessorEditor()
+{
+    audioProcessor.getPresets().removeChangeListener (this);
+    stopTimer();
+    analyser.stop();
+    audioProcessor.setMeteringEnabled (false);
+}
+
+//==============================================================================
+void NewProjectAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+
+    if (g.clipRegionIntersects (spectrumArea))
+        paintSpectrum (g);
+
+    auto area = meterArea;
+    const auto bandWidth = area.getWidth() / static_cast<int> (meters.size());
+
+    for (size_t band = 0; band < meters.size(); ++band)
+        paintBand (g, area.removeFromLeft (bandWidth).reduced (5, 0), band);
+
+    g.setColour (juce::Colours::lightgrey);
+    g.setFont (12.0f);
+    g.drawFittedText (loadText, loadArea, juce::Justification::centredRight, 1);
+
+    g.setColour (juce::Colours::orange);
+    g.drawFittedText (restartNotice, noticeArea, juce::Justification::centredLeft, 1);
+}
+
+// Input and output level (RMS filled, peak as a line), with the gain
+// reduction hanging down from the top between them.
+void NewProjectAudioProcessorEditor::paintBand (juce::Graphics& g, juce::Rectangle<int> area, size_t band) const
+{
+    const auto& meter = meters[band];
+
+    g.setColour (juce::Colours::white);
+    g.setFont (14.0f);
+    g.drawFittedText (Params::BandName (band, NewProjectAudioProcessor::NumBands),
+                      area.removeFromTop (20), juce::Justification::centred, 1);
+
+    const auto barWidth = area.getWidth() / 3;
+
+    auto drawLevel = [&g] (juce::Rectangle<int> bar, float rms, float peak)
+    {
+        g.setColour (juce::Colours::darkgrey);
+        g.fillRect (bar);
+
+        const auto height = static_cast<float> (bar.getHeight());
+        g.setColour (juce::Colours::limegreen);
+        g.fillRect (bar.withTop (bar.getBottom() - juce::roundToInt (height * meterProportion (rms))));
+
+        const auto peakY = static_cast<float> (bar.getBottom()) - height * meterProportion (peak);
+        g.setColour (peak > 1.0f ? juce::Colours::red : juce::Colours::white);
+        g.drawHorizontalLine (juce::roundToInt (peakY), static_cast<float> (bar.getX()), static_cast<float> (bar.getRight()));
+    };
+
+    drawLevel (area.removeFromLeft (barWidth).reduced (2, 0), meter.inputRms, meter.inputPeak);
+
+    auto reduction = area.removeFromLeft (barWidth).reduced (2, 0);
+    g.setColour (juce::Colours::darkgrey);
+    g.fillRect (reduction);
+    g.setColour (juce::Colours::orange);
+    const auto depth = juce::jlimit (0.0f, 1.0f, meter.gainReduction / gainReductionRangeDb);
+    g.fillRect (reduction.withHeight (juce::roundToInt (static_cast<float> (reduction.getHeight()) * depth)));
+
+    drawLevel (area.reduced (2, 0), meter.outputRms, meter.outputPeak);
+}
+
+// Input spectrum filled behind the output's outline, with the crossovers
+// marked. The analyser's paths are in a unit square.
+void NewProjectAudioProcessorEditor::paintSpectrum (juce::Graphics& g) const
+{
+    const auto area = spectrumArea.toFloat();
+    g.setColour (juce::Colours::black);
+    g.fillRect (area);
+
+    auto xFor = [&area] (float frequency)
+    {
+        return area.getX() + area.getWidth() * SpectrumAnalyser::xForFrequency (frequency);
+    };
+
+    g.setColour (juce::Colours::white.withAlpha (0.15f));
+    for (auto frequency : { 100.0f, 1000.0f, 10000.0f })
+        g.drawVerticalLine (juce::roundToInt (xFor (frequency)), area.getY(), area.getBottom());
+
+    const auto toArea = juce::AffineTransform::scale (area.getWidth(), area.getHeight()).translated (area.getX(), area.getY());
+
+    g.saveState();
+    g.reduceClipRegion (spectrumArea);
+
+    auto filled = inputSpectrum;
+    filled.lineTo (1.0f, 1.0f);
+    filled.lineTo (0.0f, 1.0f);
+    filled.closeSubPath();
+    g.setColour (juce::Colours::grey.withAlpha (0.5f));
+    g.fillPath (filled, toArea);
+
+    g.setColour (juce::Colours::skyblue);
+    g.strokePath (outputSpectrum, juce::PathStrokeType (1.5f), toArea);
+
+    g.restoreState();
+
+    g.setColour (juce::Colours::orange);
+    for (auto frequency : shownCrossovers)
+        g.drawVerticalLine (juce::roundToInt (xFor (frequency)), area.getY(), area.getBottom());
+}
+
+void NewProjectAudioProcessorEditor::resized()
+{
+    auto area = getLocalBounds().reduced (10);
+
+    auto presetBar = area.removeFromTop (24);
+    compareB.setBounds (presetBar.removeFromRight (30));
+    presetBar.removeFromRight (4);
+    compareA.setBounds (presetBar.removeFromRight (30));
+    presetBar.removeFromRight (10);
+    presetBox.setBounds (presetBar.removeFromLeft (juce::jmin (250, presetBar.getWidth())));
+    noticeArea = presetBar.withTrimmedLeft (10);
+    area.removeFromTop (10);
+
+    loadArea = area.removeFromBottom (NewProjectAudioProcessor::Profiler::isEnabled ? 16 : 0);
+    spectrumArea = area.removeFromTop (area.getHeight() / 2);
+    area.removeFromTop (10);
+    meterArea = area;
+}
+
+void NewProjectAudioProcessorEditor::changeListenerCallback (juce::ChangeBroadcaster*)
+{
+    refreshPresetList();
+}
+
+// Item IDs are program numbers plus one; factory and user presets are
+// separated by a line.
+void NewProjectAudioProcessorEditor::refreshPresetList()
+{
+    auto& presets = audioProcessor.getPresets();
+    presetBox.clear (juce::dontSendNotification);
+
+    for (int i = 0; i < presets.getNumPresets(); ++i)
+    {
+        if (i > 0 && presets.isFactoryPreset (i - 1) && ! presets.isFactoryPreset (i))
+            presetBox.addSeparator();
+
+        presetBox.addItem (presets.getName (i), i + 1);
+    }
+
+    presetBox.setSelectedId (audioProcessor.getCurrentProgram() + 1, juce::dontSendNotification);
+}
+
+// A preset sets everything, Oversampling and the other settings that make
+// the processor prepare again included, so the user is told when the audio
+// is about to restart for one.
+void NewProjectAudioProcessorEditor::selectPreset (int index)
+{
+    const auto changes = audioProcessor.getPresets().getPreparingChanges (index);
+
+    if (! changes.isEmpty())
+    {
+        restartNotice = "Restarting audio for " + changes.joinIntoString (", ");
+        restartNoticeEnd = juce::Time::getMillisecondCounter() + restartNoticeMs;
+        repaint (noticeArea);
+    }
+
+    audioProcessor.setCurrentProgram (index);
+    audioProcessor.updateHostDisplay (juce::AudioProcessor::ChangeDetails().withProgramChanged (true));
+}
+
+void NewProjectAudioProcessorEditor::selectCompareSlot (int slot)
+{
+    audioProcessor.getPresets().selectCompareSlot (slot);
+    compareA.setToggleState (slot == 0, juce::dontSendNotification);
+    compareB.setToggleState (slot == 1, juce::dontSendNotification);
+}
+
+void NewProjectAudioProcessorEditor::visibilityChanged()
+{
+    updateLiveViews();
+}
+
+// The processor only measures, and the analyser only runs, while the editor
+// can be seen.
+void NewProjectAudioProcessorEditor::updateLiveViews()
+{
+    const auto shouldRun = isVisible();
+    audioProcessor.setMeteringEnabled (shouldRun);
+
+    if (shouldRun)
+    {
+        analyser.setSampleRate (audioProcessor.getSampleRate());
+        analyser.start();
+        startTimerHz (refreshHz);
+    }
+    else
+    {
+        stopTimer();
+        analyser.stop();
+    }
+}
+
+void NewProjectAudioProcessorEditor::timerCallback()
+{
+    analyser.setSampleRate (audioProcessor.getSampleRate());
+
+    auto changed = false;
+
+    for (size_t band = 0; band < meters.size(); ++band)
+    {
+        const auto latest = audioProcessor.getBandMeter (band).read();
+        auto& shown = meters[band];
+        const auto previous = shown;
+
+        // falls back towards the latest value, and settles on it once it's close
+        auto fall = [] (float latestValue, float shownValue, float decay)
+        {
+            const auto decayed = shownValue * decay;
+            return decayed - latestValue < 1.0e-4f ? latestValue : decayed;
+        };
+
+        shown.inputPeak = fall (latest.inputPeak, shown.inputPeak, peakDecayPerFrame);
+        shown.outputPeak = fall (latest.outputPeak, shown.outputPeak, peakDecayPerFrame);
+        shown.gainReduction = fall (latest.gainReduction, shown.gainReduction, gainReductionDecayPerFrame);
+        shown.inputRms = latest.inputRms;
+        shown.outputRms = latest.outputRms;
+
+        changed = changed || std::memcmp (&previous, &shown, sizeof (shown)) != 0;
+    }
+
+    // idle meters don't cost a repaint
+    if (changed)
+        repaint (meterArea);
+
+    auto spectrumChanged = analyser.getPaths (inputSpectrum, outputSpectrum);
+
+    for (size_t split = 0; split < crossovers.size(); ++split)
+    {
+        const auto frequency = crossovers[split]->load();
+        spectrumChanged = spectrumChanged || frequency != shownCrossovers[split];
+        shownCrossovers[split] = frequency;
+    }
+
+    if (spectrumChanged)
+        repaint (spectrumArea);
+
+    if (restartNotice.isNotEmpty() && juce::Time::getMillisecondCounter() >= restartNoticeEnd)
+    {
+        restartNotice.clear();
+        repaint (noticeArea);
+    }
+
+    updateLoadText();
+}
+
+// The mean load of the blocks since the last frame, the peak and the
+// overloads so far, the stage that takes longest on average, and whether
+// the chain is asleep on a silent input.
+void NewProjectAudioProcessorEditor::updateLoadText()
+{
+    using Profiler = NewProjectAudioProcessor::Profiler;
+
+    if (! Profiler::isEnabled)
+        return;
+
+    audioProcessor.getProfiler().read (profile);
+
+    // the counts went back to zero
+    if (profile.numBlocks < shownBlocks)
+    {
+        shownBlocks = 0;
+        shownTotalLoad = 0;
+    }
+
+    // nothing processed since the last frame: the old load stays up
+    if (profile.numBlocks == shownBlocks)
+        return;
+
+    const auto load = (profile.totalLoad - shownTotalLoad) / static_cast<double> (profile.numBlocks - shownBlocks);
+    shownBlocks = profile.numBlocks;
+    shownTotalLoad = profile.totalLoad;
+
+    size_t slowest = 0;
+    for (size_t stage = 1; stage < Profiler::numStages; ++stage)
+        if (profile.stages[stage].getMean() > profile.stages[slowest].getMean())
+            slowest = stage;
+
+    auto text = "DSP " + juce::String (100.0 * load, 1) + "%   peak " + juce::String (100.0 * profile.peakLoad, 1) + "%   "
+              + juce::String (static_cast<juce::int64> (profile.numOverloads)) + " overloads   slowest: "
+              + Profiler::getStageName (slowest)
+              + (audioProcessor.isSleeping() ? "   (asleep on silence)" : "");
+
+    if (text != loadText)
+    {
+        loadText = text;
+        repaint (loadArea);
+    }
+}
@@ -1,33 +1,82 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-#include "PluginProcessor.h"
-
-//==============================================================================
-/**
-*/
-class NewProjectAudioProcessorEditor  : public juce::AudioProcessorEditor
-{
-public:
-    NewProjectAudioProcessorEditor (NewProjectAudioProcessor&);
-    ~NewProjectAudioProcessorEditor() override;
-
-    //==============================================================================
-    void paint (juce::Graphics&) override;
-    void resized() override;
-
-private:
-    // This reference is provided as a quick way for your editor to
-    // access the processor object that created it.
-    NewProjectAudioProcessor& audioProcessor;
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NewProjectAudioProcessorEditor)
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "SpectrumAnalyser.h"
+
+//==============================================================================
+/**
+*/
+class NewProjectAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                        private juce::Timer,
+                                        private juce::ChangeListener
+{
+public:
+    NewProjectAudioProcessorEditor (NewProjectAudioProcessor&);
+    ~NewProjectAudioProcessorEditor() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+    void timerCallback() override;
+    void updateLiveViews();
+
+    void changeListenerCallback (juce::ChangeBroadcaster*) override;
+    void refreshPresetList();
+    void selectPreset (int index);
+    void selectCompareSlot (int slot);
+
+    // The meters and the spectrum are redrawn at most this often, however
+    // small the host's blocks are. Between frames the processor holds the
+    // peaks and the analyser keeps working on its own thread.
+    static constexpr int refreshHz = 30;
+
+    // How fast the displayed peaks and gain reduction fall back, per frame.
+    static constexpr float peakDecayPerFrame = 0.9f;
+    static constexpr float gainReductionDecayPerFrame = 0.8f;
+
+    // A preset that changes a setting which restarts the audio says so
+    // next to the preset box for this long.
+    static constexpr juce::uint32 restartNoticeMs = 4000;
+
+    void paintBand (juce::Graphics&, juce::Rectangle<int> area, size_t band) const;
+    void paintSpectrum (juce::Graphics&) const;
+    void updateLoadText();
+
+    std::array<BandMeter::Snapshot, NewProjectAudioProcessor::NumBands> meters{};
+
+    SpectrumAnalyser analyser;
+    juce::Path inputSpectrum, outputSpectrum;
+    std::array<std::atomic<float>*, NewProjectAudioProcessor::NumBands - 1> crossovers{};
+    std::array<float, NewProjectAudioProcessor::NumBands - 1> shownCrossovers{};
+    juce::Rectangle<int> spectrumArea, meterArea, loadArea, noticeArea;
+
+    // The profiler's counts only grow, so the load shown is the change
+    // since the previous frame.
+    NewProjectAudioProcessor::Profiler::Snapshot profile;
+    juce::uint64 shownBlocks { 0 };
+    double shownTotalLoad { 0 };
+    juce::String loadText;
+
+    juce::ComboBox presetBox;
+    juce::String restartNotice;
+    juce::uint32 restartNoticeEnd { 0 };
+    juce::TextButton compareA { "A" }, compareB { "B" };
+
+    // This reference is provided as a quick way for your editor to
+    // access the processor object that created it.
+    NewProjectAudioProcessor& audioProcessor;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NewProjectAudioProcessorEditor)
+};
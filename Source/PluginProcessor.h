@@ -1,196 +1,254 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#pragma once
-/*
-* Roadmap, 
-* 1.) split audio into 3 bands - check
-* 2.) create parameters to control where this split happens. -check
-* 3.) check that splitting into 3 bands produces no audible artifacts. -check
-* 4.) create audio paramters for the 3 band compressors. these need to live in the 
-* band instances. -check
-* 5.) add 2 remaining compressors. -check
-* 6.) add ability to mute/solo/bypass individual compressors. - check
-* 7.) add input and output gain to offset changes in output levels. -check
-*/
-#include <JuceHeader.h>
-namespace Params{
-    enum Names {
-        Low_Mid_Crossover_Freq,
-        Mid_High_Crossover_Freq,
-
-        Threshold_Low_Band,
-        Threshold_Mid_Band,
-        Threshold_High_Band, 
-
-        Attack_Low_Band,
-        Attack_Mid_Band,
-        Attack_High_Band, 
-
-        Release_Low_Band, 
-        Release_Mid_Band,
-        Release_High_Band, 
-
-        Ratio_Low_Band, 
-        Ratio_Mid_Band,
-        Ratio_High_Band, 
-
-        Bypassed_Low_Band, 
-        Bypassed_Mid_Band, 
-        Bypassed_High_Band,
-
-        Mute_Low_Band,
-        Mute_Mid_Band,
-        Mute_High_Band,
-
-        Solo_Low_Band,
-        Solo_Mid_Band,
-        Solo_High_Band, 
-
-        Input_Gain,
-        Output_Gain
-        
-     };
-
-    inline const std::map<Names, juce::String>& GetParams() {
-        static std::map<Names, juce::String> params = {
-            {Low_Mid_Crossover_Freq,"Low Mid Crossover Freq"},
-            {Mid_High_Crossover_Freq, "Mid High Crossover Freq" },
-            {Threshold_Low_Band, "Threshold Low Band"},
-            {Threshold_Mid_Band, "Threshold Mid Band"},
-            {Threshold_High_Band, "Threshold High Band"}, 
-            {Release_Low_Band, "Release Low Band"},
-            {Release_Mid_Band, "Release Mid Band"},
-            {Release_High_Band, "Release High Band"},
-            {Ratio_Low_Band, "Ratio Low Band"},
-            {Ratio_Mid_Band, "Ratio Mid Band"},
-            {Ratio_High_Band, "Ratio High Band"},
-            {Bypassed_Low_Band,"Bypassed Low Band"},
-            {Bypassed_Mid_Band, "Bypassed Mid Band"},
-            {Bypassed_High_Band, "Bypassed High Band"},
-            {Mute_Low_Band,"Mute Low Band"},
-            {Mute_Mid_Band, "Mute Mid Band"},
-            {Mute_High_Band, "Mute High Band"},
-            {Solo_Low_Band,"Solo Low Band"},
-            {Solo_Mid_Band, "Solo Mid Band"},
-            {Solo_High_Band, "Solo High Band"},
-            {Input_Gain, "Input Gain"},
-            {Output_Gain, "Output Gain"}
-        };
-        return params;
-    }
-}
-struct CompressorBand {
-    juce::AudioParameterFloat* Attack{ nullptr };
-    juce::AudioParameterFloat* Release{ nullptr };
-    juce::AudioParameterFloat* Threshold{ nullptr };
-    juce::AudioParameterChoice* ratio{ nullptr };
-    juce::AudioParameterBool* Bypassed{ nullptr };
-    juce::AudioParameterBool* Mute{ nullptr };
-    juce::AudioParameterBool* Solo{ nullptr };
-
-    void Prepare(juce::dsp::ProcessSpec& spec) {
-        compressor.prepare(spec);
-    }
-
-    void UpdateCompressorSettings() {
-        compressor.setAttack(Attack->get());
-        compressor.setRelease(Release->get());
-        compressor.setThreshold(Threshold->get());
-        compressor.setRatio(ratio->getCurrentChoiceName().getFloatValue());
-    }
-
-    void Process(juce::AudioBuffer<float>& buffer) {
-        auto block = juce::dsp::AudioBlock<float>(buffer);
-        auto context = juce::dsp::ProcessContextReplacing<float>(block);
-
-        compressor.process(context);
-    }
-private:
-    juce::dsp::Compressor<float> compressor;
-};
-
-//==============================================================================
-/**
-*/
-class NewProjectAudioProcessor  : public juce::AudioProcessor
-                            #if JucePlugin_Enable_ARA
-                             , public juce::AudioProcessorARAExtension
-                            #endif
-{
-
-   
-public:
-    //==============================================================================
-    NewProjectAudioProcessor();
-    ~NewProjectAudioProcessor() override;
-
-    //==============================================================================
-    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override;
-
-   #ifndef JucePlugin_PreferredChannelConfigurations
-    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
-   #endif
-
-    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-
-    //==============================================================================
-    juce::AudioProcessorEditor* createEditor() override;
-    bool hasEditor() const override;
-
-    //==============================================================================
-    const juce::String getName() const override;
-
-    bool acceptsMidi() const override;
-    bool producesMidi() const override;
-    bool isMidiEffect() const override;
-    double getTailLengthSeconds() const override;
-
-    //==============================================================================
-    int getNumPrograms() override;
-    int getCurrentProgram() override;
-    void setCurrentProgram (int index) override;
-    const juce::String getProgramName (int index) override;
-    void changeProgramName (int index, const juce::String& newName) override;
-
-    //==============================================================================
-    void getStateInformation (juce::MemoryBlock& destData) override;
-    void setStateInformation (const void* data, int sizeInBytes) override;
-    using APVTS = juce::AudioProcessorValueTreeState;
-    static APVTS::ParameterLayout createParameterLayout();
-    APVTS apvts{ *this, nullptr, "Parameters", createParameterLayout()};
-
-private:
-    //==============================================================================
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NewProjectAudioProcessor)
-
-        std::array<CompressorBand,3> compressors;
-    CompressorBand& lowCompBand = compressors[0];
-    CompressorBand& midCompBand = compressors[1];
-    CompressorBand& highCompBand = compressors[2];
-    using Filter = juce::dsp::LinkwitzRileyFilter<float>;
-    Filter  LP1, AP2,
-            HP1, LP2,
-                 HP2;
-
-    juce::AudioParameterFloat* lowMidCrossover{nullptr};
-    juce::AudioParameterFloat* midHighCrossover{ nullptr };
-    std::array<juce::AudioBuffer<float>, 3> FilterBuffer;
-
-    juce::AudioParameterFloat* inputGain{ nullptr };
-    juce::AudioParameterFloat* outputGain{ nullptr };
-    juce::dsp::Gain<float> inGain, outGain;
-
-    template<typename T, typename U>
-    void applyGain(T& buffer, U& Gain) {
-        auto& block = juce::dsp::AudioBlock<float>(buffer);
-        auto cxt = juce::dsp::ProcessContextReplacing<float>(block);
-        Gain.process(ctx);
-    }
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#pragma once
+/*
+* Roadmap, 
+* 1.) split audio into 3 bands - check
+* 2.) create parameters to control where this split happens. -check
+* 3.) check that splitting into 3 bands produces no audible artifacts. -check
+* 4.) create audio paramters for the 3 band compressors. these need to live in the 
+* band instances. -check
+* 5.) add 2 remaining compressors. -check
+* 6.) add ability to mute/solo/bypass individual compressors. - check
+* 7.) add input and output gain to offset changes in output levels. -check
+*/
+#include <JuceHeader.h>
+#include "Params.h"
+#include "ParameterState.h"
+#include "PresetBank.h"
+#include "DSP/AllocationGuard.h"
+#include "DSP/ChannelGroups.h"
+#include "DSP/MultiBandCompressor.h"
+#include "DSP/SampleFifo.h"
+#include "DSP/StageProfiler.h"
+
+// The number of bands is fixed per build. Three keeps the parameter IDs of
+// the original ThreeBandCompressor; anything from 2 to 8 works.
+#ifndef MBC_NUM_BANDS
+ #define MBC_NUM_BANDS 3
+#endif
+
+//==============================================================================
+/**
+*/
+class NewProjectAudioProcessor  : public juce::AudioProcessor
+                            #if JucePlugin_Enable_ARA
+                             , public juce::AudioProcessorARAExtension
+                            #endif
+                             , private juce::AudioProcessorValueTreeState::Listener
+                             , private juce::AsyncUpdater
+                             , private juce::Timer
+                             , private juce::ChangeListener
+{
+
+   
+public:
+    //==============================================================================
+    NewProjectAudioProcessor();
+    ~NewProjectAudioProcessor() override;
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+
+   #ifndef JucePlugin_PreferredChannelConfigurations
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+   #endif
+
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // Both precisions run the same templated engine.
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override;
+
+    //==============================================================================
+    const juce::String getName() const override;
+
+    bool acceptsMidi() const override;
+    bool producesMidi() const override;
+    bool isMidiEffect() const override;
+    double getTailLengthSeconds() const override;
+
+    //==============================================================================
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+    using APVTS = juce::AudioProcessorValueTreeState;
+    static constexpr size_t NumBands = MBC_NUM_BANDS;
+    static APVTS::ParameterLayout createParameterLayout();
+    APVTS apvts{ *this, nullptr, "Parameters", createParameterLayout()};
+
+    // For the editor: switches the band meters on while it is open. Only the
+    // engine for the current precision runs, so it is the one read.
+    void setMeteringEnabled(bool shouldMeter) noexcept {
+        floatEngine.compressor.setMeteringEnabled(shouldMeter);
+        doubleEngine.compressor.setMeteringEnabled(shouldMeter);
+    }
+
+    BandMeter& getBandMeter(size_t band) noexcept {
+        return isUsingDoublePrecision() ? doubleEngine.compressor.getMeter(band)
+                                        : floatEngine.compressor.getMeter(band);
+    }
+
+    // The analyser reads the input and output from these; they only fill
+    // while it is running.
+    SampleFifo& getInputSpectrumFifo() noexcept { return inputSpectrum; }
+    SampleFifo& getOutputSpectrumFifo() noexcept { return outputSpectrum; }
+
+    // The factory and user presets (the host's programs) and the A/B slots.
+    using Presets = PresetBank<NumBands>;
+    Presets& getPresets() noexcept { return presets; }
+
+    // Per stage timings and overloads of processBlock, for the editor and
+    // the headless tools. Both precisions record into the same one.
+    using Profiler = StageProfiler<NumBands>;
+    Profiler& getProfiler() noexcept { return profiler; }
+
+    // Host blocks are run through the engine in sub-blocks of this many
+    // samples, every stage back to back on each while the band buffers are
+    // still in cache. 0 runs the whole host block at once. The engine's
+    // worker pool, when it runs, always gets the whole host block, so that
+    // waking the workers is paid for once.
+    static constexpr size_t defaultSubBlockSize = 256;
+    void setSubBlockSize(size_t numSamples) noexcept { subBlockSize.store(numSamples, std::memory_order_relaxed); }
+    size_t getSubBlockSize() const noexcept { return subBlockSize.load(std::memory_order_relaxed); }
+
+    // Whether the chain is asleep on a silent input right now, and how many
+    // blocks it has slept through so far.
+    bool isSleeping() const noexcept { return sleeping.load(std::memory_order_relaxed); }
+    juce::uint64 getNumSleepingBlocks() const noexcept { return numSleepingBlocks.load(std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NewProjectAudioProcessor)
+
+    // Everything that runs at the host's sample precision. There is one of
+    // each, and prepareToPlay() only prepares the one the host asked for.
+    template <typename SampleType>
+    struct Engine {
+        MultiBandCompressor<SampleType, NumBands> compressor;
+        juce::dsp::Gain<SampleType> inGain, outGain;
+    };
+
+    Profiler profiler;
+    Engine<float> floatEngine;
+    Engine<double> doubleEngine;
+    size_t maxBlockSize{ 0 };
+    std::atomic<bool> prepareRequested{ false }, crossoversMoved{ false }, lookaheadMoved{ false };
+    const juce::StringArray crossoverParameterIDs{ getCrossoverParameterIDs() };
+    const juce::StringArray lookaheadParameterIDs{ getLookaheadParameterIDs() };
+    size_t numKeyChannels{ 0 };
+    std::atomic<size_t> subBlockSize{ defaultSubBlockSize };
+
+    // Input below this (-120 dBFS) counts as silence. Once the silence has
+    // outlasted the engine's tail and the bands have released, the output is
+    // silent too and nothing runs until the input comes back.
+    static constexpr float silenceThreshold = 1.0e-6f;
+    size_t silentSamples{ 0 };
+    std::atomic<bool> sleeping{ false };
+    std::atomic<juce::uint64> numSleepingBlocks{ 0 };
+
+    SampleFifo inputSpectrum, outputSpectrum;
+
+    ParameterState parameterState{ apvts, NumBands };
+    Presets presets{ parameterState, getPreparingParameterIDs() };
+    int currentProgram{ 0 };
+
+    juce::AudioParameterFloat* inputGain{ nullptr };
+    juce::AudioParameterFloat* outputGain{ nullptr };
+
+    template <typename SampleType>
+    Engine<SampleType>& getEngine() noexcept {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleEngine;
+        else
+            return floatEngine;
+    }
+
+    template <typename SampleType>
+    void prepareEngine(juce::dsp::ProcessSpec& spec);
+
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer);
+
+    template <typename SampleType>
+    void readSettings(Engine<SampleType>& engine);
+
+    template <typename SampleType>
+    void processChunk(Engine<SampleType>& engine, const juce::dsp::AudioBlock<SampleType>& block,
+                      const juce::dsp::AudioBlock<const SampleType>& key);
+
+    // Changing the oversampling reallocates and changes the latency,
+    // Parallel Bands starts or stops threads, and the crossover and stereo
+    // modes change what the filters and envelopes hold, so they are picked
+    // up by preparing again on the message thread. A preset that changes
+    // any of them so restarts the audio once (see PresetBank).
+    //
+    // A band's lookahead changes in place on the audio thread; the message
+    // thread only tells the host when that moved the latency.
+    //
+    // A moved crossover wakes the linear phase designer, and only has its
+    // coefficients added to the shared cache once it has stayed put for
+    // crossoverSettleMs, so a drag or an automation lane doesn't fill the
+    // cache with every value it passes.
+    static constexpr int crossoverSettleMs = 500;
+    static juce::StringArray getPreparingParameterIDs();
+    static juce::StringArray getCrossoverParameterIDs();
+    static juce::StringArray getLookaheadParameterIDs();
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void timerCallback() override;
+    void changeListenerCallback(juce::ChangeBroadcaster*) override;
+
+    // A vectorised peak scan of every channel.
+    template <typename SampleType>
+    static bool isBelowSilence(const juce::AudioBuffer<SampleType>& buffer) {
+        return buffer.getNumChannels() == 0
+            || buffer.getMagnitude(0, buffer.getNumSamples()) < static_cast<SampleType>(silenceThreshold);
+    }
+
+    template <typename SampleType>
+    static bool isUnity(const juce::dsp::Gain<SampleType>& Gain) {
+        return !Gain.isSmoothing() && Gain.getGainLinear() == SampleType(1);
+    }
+
+    template<typename T, typename SampleType>
+    void applyGain(const T& buffer, juce::dsp::Gain<SampleType>& Gain) {
+        auto block = juce::dsp::AudioBlock<SampleType>(buffer);
+        auto ctx = juce::dsp::ProcessContextReplacing<SampleType>(block);
+        Gain.process(ctx);
+    }
+
+    // The input gain and the mid/side encode in one pass over a stereo
+    // block. The gain steps once per sample frame, as in Gain::process().
+    template <typename SampleType>
+    static void encodeMidSide(const juce::dsp::AudioBlock<SampleType>& block, juce::dsp::Gain<SampleType>& Gain) {
+        jassert(block.getNumChannels() == 2);
+        auto* left = block.getChannelPointer(0);
+        auto* right = block.getChannelPointer(1);
+
+        for (size_t i{ 0 }; i < block.getNumSamples(); ++i) {
+            const auto halfGain = Gain.processSample(SampleType(0.5));
+            const auto l = left[i];
+            const auto r = right[i];
+            left[i] = (l + r) * halfGain;
+            right[i] = (l - r) * halfGain;
+        }
+    }
+};
@@ -0,0 +1,465 @@
+/*
+  ==============================================================================
+
+    PresetBank.h
+    Factory and user presets, and the A/B compare slots.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Params.h"
+#include "ParameterState.h"
+
+// The headless tools build the processor too, and turn this off so they
+// neither start the bank's thread nor touch the user's bank file; their user
+// presets then only live in memory.
+#ifndef MBC_USER_PRESETS
+ #define MBC_USER_PRESETS 1
+#endif
+
+/*
+* The user presets of every instance in the process, held through a
+* juce::SharedResourcePointer. One list and one thread serve them all, so a
+* preset saved in one instance is in the next save of any other, and a
+* session of a hundred instances reads the file once.
+*
+* The bank file is a short header followed by name and ParameterState blob
+* pairs:
+*
+*   uint32 magic ("MBCB")   uint16 version   uint16 preset count
+*   per preset: uint16 name bytes, UTF-8 name, uint32 blob bytes, blob
+*
+* It is memory mapped and read on the bank's thread when the first instance
+* creates the bank, and written back there, through a temporary file,
+* whenever a user preset changes. Presets are kept as their blobs, and every
+* instance decodes them over its own defaults. Listeners hear about changes
+* on the message thread.
+*/
+template <size_t NumBands>
+class UserPresetBank : public juce::ChangeBroadcaster,
+                       private juce::Thread,
+                       private juce::AsyncUpdater {
+public:
+    static constexpr juce::uint32 bankMagic = 0x4243424d; // "MBCB"
+    static constexpr juce::uint16 bankVersion = 1;
+
+    UserPresetBank() : juce::Thread("Preset bank"), bankFile(getDefaultBankFile()) {
+       #if MBC_USER_PRESETS
+        loadRequested = true;
+        startThread(juce::Thread::Priority::background);
+       #endif
+    }
+
+    // A save that is still pending is written before the thread stops.
+    ~UserPresetBank() override {
+        signalThreadShouldExit();
+        notify();
+        stopThread(2000);
+        cancelPendingUpdate();
+    }
+
+    // Builds with other band counts can't share presets, so each has its own.
+    static juce::File getDefaultBankFile() {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile(JucePlugin_Name)
+            .getChildFile("UserPresets" + juce::String(static_cast<int>(NumBands)) + "Bands.mbcbank");
+    }
+
+    //==============================================================================
+    // message thread
+
+    // In the order they were saved.
+    int getNumPresets() const {
+        const juce::ScopedLock sl(lock);
+        return static_cast<int>(presets.size());
+    }
+
+    juce::String getName(int index) const {
+        const juce::ScopedLock sl(lock);
+        return juce::isPositiveAndBelow(index, static_cast<int>(presets.size())) ? presets[static_cast<size_t>(index)].name
+                                                                                 : juce::String();
+    }
+
+    // Overwrites the start of values, which holds the caller's defaults, as
+    // ParameterState::decode() does.
+    bool decode(int index, ParameterState::Values& values) const {
+        const juce::ScopedLock sl(lock);
+        if (!juce::isPositiveAndBelow(index, static_cast<int>(presets.size())))
+            return false;
+
+        const auto& blob = presets[static_cast<size_t>(index)].blob;
+        return ParameterState::decode(blob.getData(), static_cast<int>(blob.getSize()), NumBands, values);
+    }
+
+    // Saves the values, over a preset of the same name if there is one.
+    // Returns the preset's index.
+    int save(const juce::String& name, const ParameterState::Values& values) {
+        Preset preset{ name, {} };
+        ParameterState::encode(values, NumBands, preset.blob);
+
+        int index;
+        {
+            const juce::ScopedLock sl(lock);
+            auto existing = std::find_if(presets.begin(), presets.end(),
+                                         [&name](const Preset& p) { return p.name == name; });
+
+            if (existing != presets.end())
+                *existing = std::move(preset);
+            else
+                existing = presets.insert(presets.end(), std::move(preset));
+
+            index = static_cast<int>(existing - presets.begin());
+        }
+
+        requestSave();
+        return index;
+    }
+
+    bool rename(int index, const juce::String& newName) {
+        if (newName.isEmpty())
+            return false;
+
+        {
+            const juce::ScopedLock sl(lock);
+            if (!juce::isPositiveAndBelow(index, static_cast<int>(presets.size())))
+                return false;
+
+            presets[static_cast<size_t>(index)].name = newName;
+        }
+
+        requestSave();
+        return true;
+    }
+
+    bool remove(int index) {
+        {
+            const juce::ScopedLock sl(lock);
+            if (!juce::isPositiveAndBelow(index, static_cast<int>(presets.size())))
+                return false;
+
+            presets.erase(presets.begin() + index);
+        }
+
+        requestSave();
+        return true;
+    }
+
+private:
+    struct Preset {
+        juce::String name;
+        juce::MemoryBlock blob;
+    };
+
+    // Without MBC_USER_PRESETS there is no thread, and the change is only
+    // announced.
+    void requestSave() {
+       #if MBC_USER_PRESETS
+        saveRequested = true;
+        notify();
+       #else
+        triggerAsyncUpdate();
+       #endif
+    }
+
+    void run() override {
+        while (!threadShouldExit()) {
+            if (loadRequested.exchange(false))
+                loadBank();
+
+            if (saveRequested.exchange(false))
+                saveBank();
+
+            wait(-1);
+        }
+
+        if (saveRequested.exchange(false))
+            saveBank();
+    }
+
+    void handleAsyncUpdate() override { sendChangeMessage(); }
+
+    // Presets saved before the file was read are kept, after the ones read.
+    void loadBank() {
+        juce::MemoryMappedFile mapped(bankFile, juce::MemoryMappedFile::readOnly);
+        if (mapped.getData() == nullptr)
+            return;
+
+        auto loaded = parseBank(static_cast<const char*>(mapped.getData()), mapped.getSize());
+
+        {
+            const juce::ScopedLock sl(lock);
+            for (auto& preset : presets)
+                loaded.push_back(std::move(preset));
+
+            presets = std::move(loaded);
+        }
+
+        triggerAsyncUpdate();
+    }
+
+    // Stops at the first entry that doesn't fit, and skips presets that
+    // don't decode (e.g. from another band count).
+    static std::vector<Preset> parseBank(const char* data, size_t size) {
+        std::vector<Preset> result;
+        if (size < 8 || juce::ByteOrder::littleEndianInt(data) != bankMagic)
+            return result;
+
+        ParameterState::Values check(static_cast<size_t>(ParameterState::getLayout(NumBands).size()));
+        const auto count = juce::ByteOrder::littleEndianShort(data + 6);
+        size_t position{ 8 };
+
+        for (int i = 0; i < count; ++i) {
+            if (position + 2 > size)
+                break;
+
+            const auto nameBytes = static_cast<size_t>(juce::ByteOrder::littleEndianShort(data + position));
+            position += 2;
+            if (position + nameBytes + 4 > size)
+                break;
+
+            const auto name = juce::String::fromUTF8(data + position, static_cast<int>(nameBytes));
+            position += nameBytes;
+
+            const auto blobBytes = static_cast<size_t>(juce::ByteOrder::littleEndianInt(data + position));
+            position += 4;
+            if (position + blobBytes > size)
+                break;
+
+            if (ParameterState::decode(data + position, static_cast<int>(blobBytes), NumBands, check))
+                result.push_back({ name, juce::MemoryBlock(data + position, blobBytes) });
+
+            position += blobBytes;
+        }
+
+        return result;
+    }
+
+    void saveBank() {
+        juce::MemoryOutputStream stream;
+        {
+            const juce::ScopedLock sl(lock);
+            const auto count = juce::jmin(presets.size(), size_t(0xffff));
+            stream.writeInt(static_cast<int>(bankMagic));
+            stream.writeShort(static_cast<short>(bankVersion));
+            stream.writeShort(static_cast<short>(count));
+
+            for (size_t i{ 0 }; i < count; ++i) {
+                const auto& preset = presets[i];
+                const auto name = preset.name.toUTF8();
+                const auto nameBytes = juce::jmin(name.sizeInBytes() - 1, size_t(0xffff));
+
+                stream.writeShort(static_cast<short>(nameBytes));
+                stream.write(name.getAddress(), nameBytes);
+                stream.writeInt(static_cast<int>(preset.blob.getSize()));
+                stream.write(preset.blob.getData(), preset.blob.getSize());
+            }
+        }
+
+        bankFile.getParentDirectory().createDirectory();
+
+        juce::TemporaryFile temp(bankFile);
+        if (temp.getFile().replaceWithData(stream.getData(), stream.getDataSize()))
+            temp.overwriteTargetFileWithTemporary();
+
+        triggerAsyncUpdate();
+    }
+
+    const juce::File bankFile;
+
+    mutable juce::CriticalSection lock;
+    std::vector<Preset> presets;
+
+    std::atomic<bool> loadRequested{ false }, saveRequested{ false };
+};
+
+/*
+* One instance's view of the presets: the factory ones, built in code, then
+* the shared user bank's. Every preset is a ParameterState::Values, so
+* switching to one is a single ParameterState::apply(): the audio thread
+* takes the whole preset at a block boundary and the engine's smoothing
+* glides over to it, instead of the ValueTree round trip of replaceState().
+*
+* Settings that make the processor prepare again (oversampling and the
+* like, given as preparingIDs) are applied too, so picking a preset
+* restarts the audio once when it changes any of them. The editor asks
+* getPreparingChanges() first, to tell the user.
+*
+* The two A/B slots only live in memory: selecting the other slot keeps the
+* current settings in the one being left and applies the other's, or just
+* starts it from the current settings the first time.
+*/
+template <size_t NumBands>
+class PresetBank : public juce::ChangeBroadcaster,
+                   private juce::ChangeListener {
+public:
+    PresetBank(ParameterState& s, const juce::StringArray& ids) : state(s), preparingIDs(ids) {
+        state.getDefaults(defaults);
+        addFactoryPresets();
+
+        const auto layout = ParameterState::getLayout(NumBands);
+        for (auto& id : preparingIDs) {
+            const auto index = layout.indexOf(id);
+            jassert(index >= 0);
+            preparingIndices.push_back(static_cast<size_t>(index));
+        }
+
+        userPresets->addChangeListener(this);
+    }
+
+    ~PresetBank() override {
+        userPresets->removeChangeListener(this);
+    }
+
+    //==============================================================================
+    // message thread
+
+    // Factory presets first, then the user's in the order they were saved.
+    int getNumPresets() const {
+        return static_cast<int>(factoryPresets.size()) + userPresets->getNumPresets();
+    }
+
+    juce::String getName(int index) const {
+        if (index < 0)
+            return {};
+
+        return isFactoryPreset(index) ? factoryPresets[static_cast<size_t>(index)].name
+                                      : userPresets->getName(toUserIndex(index));
+    }
+
+    bool isFactoryPreset(int index) const noexcept {
+        return juce::isPositiveAndBelow(index, static_cast<int>(factoryPresets.size()));
+    }
+
+    bool load(int index) {
+        if (!decode(index, scratch))
+            return false;
+
+        state.apply(scratch);
+        return true;
+    }
+
+    // The IDs of the preparing settings that loading the preset would
+    // change, each of which restarts the audio. Empty if it changes none.
+    juce::StringArray getPreparingChanges(int index) {
+        juce::StringArray changes;
+        if (!decode(index, scratch))
+            return changes;
+
+        state.capture(current);
+        for (size_t i{ 0 }; i < preparingIndices.size(); ++i)
+            if (scratch[preparingIndices[i]] != current[preparingIndices[i]])
+                changes.add(preparingIDs[static_cast<int>(i)]);
+
+        return changes;
+    }
+
+    // Saves the current settings, over a user preset of the same name if
+    // there is one. Returns the preset's index.
+    int saveUserPreset(const juce::String& name) {
+        state.capture(current);
+        return static_cast<int>(factoryPresets.size()) + userPresets->save(name, current);
+    }
+
+    bool renamePreset(int index, const juce::String& newName) {
+        return !isFactoryPreset(index) && userPresets->rename(toUserIndex(index), newName);
+    }
+
+    bool deletePreset(int index) {
+        return !isFactoryPreset(index) && userPresets->remove(toUserIndex(index));
+    }
+
+    // slot 0 is A, 1 is B
+    void selectCompareSlot(int slot) {
+        jassert(slot == 0 || slot == 1);
+        if (slot == compareSlot)
+            return;
+
+        state.capture(compareSlots[static_cast<size_t>(compareSlot)]);
+        compareSlot = slot;
+
+        auto& values = compareSlots[static_cast<size_t>(slot)];
+        if (values.empty())
+            state.capture(values);
+        else
+            state.apply(values);
+    }
+
+    int getCompareSlot() const noexcept { return compareSlot; }
+
+private:
+    struct Preset {
+        juce::String name;
+        ParameterState::Values values;
+    };
+
+    int toUserIndex(int index) const noexcept { return index - static_cast<int>(factoryPresets.size()); }
+
+    bool decode(int index, ParameterState::Values& dest) const {
+        if (index < 0)
+            return false;
+
+        if (isFactoryPreset(index)) {
+            dest = factoryPresets[static_cast<size_t>(index)].values;
+            return true;
+        }
+
+        dest = defaults;
+        return userPresets->decode(toUserIndex(index), dest);
+    }
+
+    // the user bank finished loading or changed, here or in another instance
+    void changeListenerCallback(juce::ChangeBroadcaster*) override { sendChangeMessage(); }
+
+    // Each factory preset sets these on every band and leaves the rest at
+    // their defaults. The ratio is an index into Params::RatioChoices.
+    void addFactoryPresets() {
+        struct Setting {
+            Params::Names name;
+            float value;
+        };
+
+        const auto layout = ParameterState::getLayout(NumBands);
+
+        auto add = [this, &layout](const char* name, std::initializer_list<Setting> settings) {
+            Preset preset{ name, defaults };
+
+            for (auto& setting : settings) {
+                for (size_t band{ 0 }; band < NumBands; band++) {
+                    const auto index = layout.indexOf(Params::BandParamID(setting.name, band, NumBands));
+                    jassert(index >= 0);
+                    preset.values[static_cast<size_t>(index)] = setting.value;
+                }
+            }
+
+            factoryPresets.push_back(std::move(preset));
+        };
+
+        add("Default", {});
+        add("Gentle Glue", { { Params::Threshold, -18.f }, { Params::Ratio, 2.f }, { Params::Attack, 30.f },
+                             { Params::Release, 200.f }, { Params::Knee, 6.f }, { Params::Link, 1.f } });
+        add("Drum Bus", { { Params::Threshold, -20.f }, { Params::Ratio, 4.f }, { Params::Attack, 10.f },
+                          { Params::Release, 120.f }, { Params::Knee, 3.f }, { Params::Link, 1.f } });
+        add("Vocal Control", { { Params::Threshold, -24.f }, { Params::Ratio, 3.f }, { Params::Attack, 5.f },
+                               { Params::Release, 80.f }, { Params::Knee, 6.f }, { Params::Lookahead, 2.f } });
+        add("Mastering", { { Params::Threshold, -12.f }, { Params::Ratio, 1.f }, { Params::Attack, 50.f },
+                           { Params::Release, 250.f }, { Params::Knee, 12.f }, { Params::Link, 1.f },
+                           { Params::Lookahead, 5.f } });
+    }
+
+    ParameterState& state;
+    const juce::StringArray preparingIDs;
+    juce::SharedResourcePointer<UserPresetBank<NumBands>> userPresets;
+
+    // written once in the constructor
+    ParameterState::Values defaults;
+    std::vector<Preset> factoryPresets;
+    std::vector<size_t> preparingIndices;
+
+    ParameterState::Values scratch, current;
+
+    std::array<ParameterState::Values, 2> compareSlots;
+    int compareSlot{ 0 };
+};
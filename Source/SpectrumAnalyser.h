@@ -0,0 +1,195 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyser.h
+    Background FFT analysis of the input and output for the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DSP/SampleFifo.h"
+
+/*
+* Runs on its own low priority thread, so the audio thread only ever copies
+* samples into the two SampleFifos and the message thread only strokes paths.
+* Each frame the worker pulls whatever arrived, windows the latest fftSize
+* samples, transforms them, smooths the levels and turns them into a path.
+*
+* The paths are laid out in a unit square (x from xForFrequency(), y = 0 at
+* the top of the dB range), so the editor scales them to any size without
+* asking for a new analysis. Finished paths are swapped with the ones the
+* editor copies from under a lock that only those two threads share.
+*
+* The worker runs at most frameRateHz, skips frames where no audio arrived,
+* and is stopped (along with the FIFOs) while the editor is hidden.
+*/
+class SpectrumAnalyser : private juce::Thread {
+public:
+    static constexpr int fftOrder = 12;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int frameRateHz = 30;
+    static constexpr int numPoints = 256;
+
+    static constexpr float minFrequency = 20.f, maxFrequency = 20000.f;
+    static constexpr float minDb = -90.f, maxDb = 6.f;
+
+    // Levels fall back by this much per frame instead of jumping down.
+    static constexpr float fallDbPerFrame = 1.5f;
+
+    SpectrumAnalyser(SampleFifo& inputFifo, SampleFifo& outputFifo)
+        : juce::Thread("Spectrum analyser"), sources{ Source{ inputFifo }, Source{ outputFifo } } {}
+
+    ~SpectrumAnalyser() override { stop(); }
+
+    // The horizontal position of a frequency, 0 to 1 on a log scale.
+    static float xForFrequency(float frequency) noexcept {
+        return std::log(frequency / minFrequency) / std::log(maxFrequency / minFrequency);
+    }
+
+    void start() {
+        if (isThreadRunning())
+            return;
+
+        for (auto& source : sources) {
+            source.fifo.discard();
+            source.fifo.setActive(true);
+        }
+
+        startThread(juce::Thread::Priority::low);
+    }
+
+    void stop() {
+        for (auto& source : sources)
+            source.fifo.setActive(false);
+
+        stopThread(1000);
+    }
+
+    // Read on the worker for the frequency axis. 0 (not prepared yet) is ignored.
+    void setSampleRate(double newSampleRate) noexcept {
+        if (newSampleRate > 0.0)
+            sampleRate.store(newSampleRate);
+    }
+
+    // Copies the latest paths if a new frame finished since the last call.
+    bool getPaths(juce::Path& input, juce::Path& output) {
+        const juce::SpinLock::ScopedLockType lock(pathLock);
+        if (!hasNewPaths)
+            return false;
+
+        input = readyPaths[0];
+        output = readyPaths[1];
+        hasNewPaths = false;
+        return true;
+    }
+
+private:
+    struct Source {
+        explicit Source(SampleFifo& f) : fifo(f) {}
+
+        SampleFifo& fifo;
+        std::vector<float> history = std::vector<float>(fftSize, 0.f);
+        std::vector<float> levels = std::vector<float>(fftSize / 2, minDb);
+        juce::Path path;
+    };
+
+    void run() override {
+        std::vector<float> incoming(static_cast<size_t>(fftSize));
+        const auto frameMs = 1000 / frameRateHz;
+
+        while (!threadShouldExit()) {
+            const auto frameStart = juce::Time::getMillisecondCounter();
+
+            auto anyNew = false;
+            for (auto& source : sources)
+                anyNew = readNewSamples(source, incoming) || anyNew;
+
+            if (anyNew) {
+                for (auto& source : sources) {
+                    analyse(source);
+                    buildPath(source);
+                }
+
+                const juce::SpinLock::ScopedLockType lock(pathLock);
+                for (size_t i = 0; i < sources.size(); ++i)
+                    std::swap(sources[i].path, readyPaths[i]);
+                hasNewPaths = true;
+            }
+
+            const auto elapsed = static_cast<int>(juce::Time::getMillisecondCounter() - frameStart);
+            wait(juce::jmax(1, frameMs - elapsed));
+        }
+    }
+
+    // Slides everything that arrived into the history, keeping the newest
+    // fftSize samples.
+    static bool readNewSamples(Source& source, std::vector<float>& incoming) {
+        auto& history = source.history;
+        auto total = 0;
+
+        for (int n; (n = source.fifo.pull(incoming.data(), fftSize)) > 0; total += n) {
+            std::move(history.begin() + n, history.end(), history.begin());
+            std::copy_n(incoming.data(), n, history.end() - n);
+        }
+
+        return total > 0;
+    }
+
+    void analyse(Source& source) {
+        std::copy(source.history.begin(), source.history.end(), fftData.begin());
+        window.multiplyWithWindowingTable(fftData.data(), static_cast<size_t>(fftSize));
+        fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+        // a full scale sine comes out at 0 dB: one sided, over the Hann
+        // window's coherent gain of 0.5
+        const auto scale = 4.f / static_cast<float>(fftSize);
+
+        for (size_t bin = 0; bin < source.levels.size(); ++bin) {
+            const auto db = juce::Decibels::gainToDecibels(fftData[bin] * scale, minDb);
+            auto& level = source.levels[bin];
+            level = juce::jmax(db, level - fallDbPerFrame);
+        }
+    }
+
+    // numPoints log spaced points, each the loudest bin it covers, so
+    // narrow peaks at the top end don't vanish between points.
+    void buildPath(Source& source) const {
+        auto& path = source.path;
+        path.clear();
+
+        const auto binsPerHz = static_cast<float>(fftSize / sampleRate.load());
+        const auto lastBin = static_cast<int>(source.levels.size()) - 1;
+        auto y = [](float db) { return juce::jmap(db, maxDb, minDb, 0.f, 1.f); };
+
+        auto previousBin = 0;
+        for (int point = 0; point < numPoints; ++point) {
+            const auto x = static_cast<float>(point) / static_cast<float>(numPoints - 1);
+            const auto frequency = minFrequency * std::pow(maxFrequency / minFrequency, x);
+            const auto bin = juce::jlimit(1, lastBin, juce::roundToInt(frequency * binsPerHz));
+
+            auto db = minDb;
+            for (auto b = juce::jmin(previousBin + 1, bin); b <= bin; ++b)
+                db = juce::jmax(db, source.levels[static_cast<size_t>(b)]);
+            previousBin = bin;
+
+            const auto pointY = y(juce::jlimit(minDb, maxDb, db));
+            if (point == 0)
+                path.startNewSubPath(x, pointY);
+            else
+                path.lineTo(x, pointY);
+        }
+    }
+
+    std::array<Source, 2> sources;
+    std::array<juce::Path, 2> readyPaths;
+    bool hasNewPaths{ false };
+    juce::SpinLock pathLock;
+
+    juce::dsp::FFT fft{ fftOrder };
+    juce::dsp::WindowingFunction<float> window{ static_cast<size_t>(fftSize), juce::dsp::WindowingFunction<float>::hann, false };
+    std::vector<float> fftData = std::vector<float>(2 * fftSize, 0.f);
+    std::atomic<double> sampleRate{ 44100.0 };
+};
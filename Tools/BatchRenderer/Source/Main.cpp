@@ -0,0 +1,391 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Offline renderer: streams audio files through the compressor.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../Common/AllocationCheck.h"
+
+#include <iostream>
+#include <map>
+
+namespace {
+    constexpr auto usage =
+        "usage: BatchRenderer --output=<dir> [options] <file or folder>...\n"
+        "\n"
+        "  --output=<dir>        where the rendered files go\n"
+        "  --preset=<file>       parameter state to render with (XML, see --write-preset)\n"
+        "  --format=wav|flac     output format, defaults to the input's\n"
+        "  --threads=<n>         worker threads, defaults to the number of cores\n"
+        "  --chunk=<samples>     samples per processBlock, default 16384\n"
+        "  --write-preset=<file> write the current (or --preset) state and exit\n"
+        "  --profile=<file>      write every worker's stage timings and overloads\n"
+        "  --overload=<fraction> share of a chunk's duration it may take, default 0.5\n"
+        "\n"
+        "Folders are searched recursively for .wav and .flac files; their\n"
+        "subfolders are mirrored under --output.\n";
+
+    // Where an input file goes, worked out up front so that two inputs can't
+    // be written to the same file.
+    struct Input {
+        juce::File file, output;
+        juce::String relativePath; // from the folder argument it was found in
+    };
+
+    struct Options {
+        juce::File outputDir;
+        juce::String format;
+        int numThreads{ 0 };
+        int chunkSize{ 16384 };
+        float overloadThreshold{ 0.5f };
+        juce::File profileFile;
+        juce::ValueTree preset;
+        std::vector<Input> inputs;
+    };
+
+    // Every worker owns its processor and reports through here, so the output
+    // of different threads doesn't interleave mid line.
+    void log(const juce::String& message, bool isError = false) {
+        static juce::CriticalSection lock;
+        const juce::ScopedLock sl(lock);
+        (isError ? std::cerr : std::cout) << message << std::endl;
+    }
+
+    bool applyPreset(NewProjectAudioProcessor& processor, const juce::ValueTree& preset) {
+        if (!preset.isValid())
+            return true;
+
+        if (!preset.hasType(processor.apvts.state.getType()))
+            return false;
+
+        processor.apvts.replaceState(preset.createCopy());
+        return true;
+    }
+
+    class RenderWorker : public juce::Thread {
+    public:
+        RenderWorker(const Options& opts, std::atomic<int>& next, std::unique_ptr<NewProjectAudioProcessor> p)
+            : juce::Thread("Render worker"), options(opts), nextFile(next), processor(std::move(p)) {
+            formatManager.registerBasicFormats();
+        }
+
+        ~RenderWorker() override {
+            stopThread(-1);
+        }
+
+        void run() override {
+            while (!threadShouldExit()) {
+                const auto index = static_cast<size_t>(nextFile++);
+                if (index >= options.inputs.size())
+                    break;
+
+                const auto& input = options.inputs[index];
+                if (auto error = renderFile(input.file, input.output); error.isNotEmpty()) {
+                    log(input.file.getFullPathName() + ": " + error, true);
+                    ++numFailed;
+                }
+            }
+        }
+
+        void writeProfile(juce::OutputStream& out) const {
+            processor->getProfiler().writeReport(out);
+            out << "slept through " << juce::String(static_cast<juce::int64>(processor->getNumSleepingBlocks())) << " silent chunks\n";
+        }
+
+        double secondsRendered{ 0 };
+        int numRendered{ 0 }, numFailed{ 0 };
+
+    private:
+        // Returns an error message, or an empty string once the file is written.
+        juce::String renderFile(const juce::File& inputFile, const juce::File& outputFile) {
+            std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+            if (reader == nullptr)
+                return "not a readable audio file";
+
+            const auto numChannels = static_cast<int>(reader->numChannels);
+            if (!setChannelLayout(numChannels))
+                return "unsupported channel count (" + juce::String(numChannels) + ")";
+
+            const auto extension = outputFile.getFileExtension();
+            auto* format = formatManager.findFormatForFileExtension(extension);
+            if (format == nullptr)
+                return "no writer for " + extension;
+
+            if (outputFile == inputFile)
+                return "output would overwrite the input";
+
+            if (!outputFile.getParentDirectory().createDirectory())
+                return "can't create " + outputFile.getParentDirectory().getFullPathName();
+
+            outputFile.deleteFile();
+            auto stream = std::make_unique<juce::FileOutputStream>(outputFile);
+            if (stream->failedToOpen())
+                return "can't write " + outputFile.getFullPathName();
+
+            std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), reader->sampleRate,
+                static_cast<unsigned int>(numChannels), bitDepthFor(*format, static_cast<int>(reader->bitsPerSample)), {}, 0));
+            if (writer == nullptr)
+                return "can't create a " + format->getFormatName() + " writer for this file";
+
+            stream.release(); // the writer owns it now
+
+            const auto chunkSize = options.chunkSize;
+            processor->prepareToPlay(reader->sampleRate, chunkSize);
+            buffer.setSize(numChannels, chunkSize, false, false, true);
+
+            // Latency is made up by dropping the first samples and running
+            // silence through at the end, so the output lines up with the input.
+            auto numToSkip = static_cast<juce::int64>(processor->getLatencySamples());
+            auto numToWrite = reader->lengthInSamples;
+
+            for (juce::int64 readPosition{ 0 }; numToWrite > 0 && !threadShouldExit(); readPosition += chunkSize) {
+                // reads past the end come back as silence
+                reader->read(&buffer, 0, chunkSize, readPosition, true, true);
+                processor->processBlock(buffer, midi);
+
+                const auto start = static_cast<int>(juce::jmin<juce::int64>(numToSkip, chunkSize));
+                const auto count = static_cast<int>(juce::jmin<juce::int64>(chunkSize - start, numToWrite));
+                numToSkip -= start;
+
+                if (count > 0 && !writer->writeFromAudioSampleBuffer(buffer, start, count))
+                    return "write failed";
+
+                numToWrite -= count;
+            }
+
+            processor->releaseResources();
+
+            secondsRendered += static_cast<double>(reader->lengthInSamples) / reader->sampleRate;
+            ++numRendered;
+
+            log("rendered " + outputFile.getFullPathName());
+            return {};
+        }
+
+        bool setChannelLayout(int numChannels) {
+            const auto set = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(set);
+            layout.inputBuses.add(juce::AudioChannelSet::disabled()); // no sidechain
+            layout.outputBuses.add(set);
+
+            return processor->setBusesLayout(layout);
+        }
+
+        // The deepest the format can write without going past the source.
+        static int bitDepthFor(juce::AudioFormat& format, int sourceBits) {
+            const auto depths = format.getPossibleBitDepths();
+            auto best = depths.isEmpty() ? 16 : depths.getFirst();
+
+            for (auto depth : depths)
+                if (depth <= sourceBits)
+                    best = juce::jmax(best, depth);
+
+            return best;
+        }
+
+        const Options& options;
+        std::atomic<int>& nextFile;
+        std::unique_ptr<NewProjectAudioProcessor> processor;
+        juce::AudioFormatManager formatManager;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+    };
+
+    // Options all take the --name=value form, so everything else is an input.
+    std::vector<Input> findInputs(const juce::ArgumentList& args) {
+        std::vector<Input> inputs;
+
+        for (int i = 0; i < args.size(); ++i) {
+            const auto& arg = args[i];
+            if (arg.isOption())
+                continue;
+
+            const auto file = arg.resolveAsFile();
+            if (!file.isDirectory()) {
+                inputs.push_back({ file, {}, file.getFileName() });
+                continue;
+            }
+
+            for (const auto& child : file.findChildFiles(juce::File::findFiles, true, "*.wav;*.flac"))
+                inputs.push_back({ child, {}, child.getRelativePathFrom(file) });
+        }
+
+        return inputs;
+    }
+
+    // Each input goes to its path relative to the folder it was found in,
+    // under the output folder. Inputs that would still end up in the same
+    // file (the same name given twice, or found under two folders) are an
+    // error, rather than two workers writing one file at once.
+    bool assignOutputs(Options& options) {
+        std::map<juce::String, const Input*> outputs;
+        auto isUnique = true;
+
+        for (auto& input : options.inputs) {
+            const auto extension = options.format.isNotEmpty() ? "." + options.format : input.file.getFileExtension();
+            input.output = options.outputDir.getChildFile(input.relativePath).withFileExtension(extension);
+
+            auto path = input.output.getFullPathName();
+            if (!juce::File::areFileNamesCaseSensitive())
+                path = path.toLowerCase();
+
+            const auto [existing, isNew] = outputs.emplace(path, &input);
+            if (!isNew) {
+                std::cerr << input.file.getFullPathName() << " and " << existing->second->file.getFullPathName()
+                          << " would both be written to " << input.output.getFullPathName() << "\n";
+                isUnique = false;
+            }
+        }
+
+        return isUnique;
+    }
+
+    // ArgumentList::getFileForOption() throws when the value is missing,
+    // which only ConsoleApplication catches.
+    juce::File fileForOption(const juce::ArgumentList& args, juce::StringRef option) {
+        const auto value = args.getValueForOption(option).unquoted();
+        return value.isEmpty() ? juce::File() : juce::File::getCurrentWorkingDirectory().getChildFile(value);
+    }
+
+    int writePreset(const Options& options, const juce::File& file) {
+        NewProjectAudioProcessor processor;
+        if (!applyPreset(processor, options.preset))
+            return 1;
+
+        auto xml = processor.apvts.copyState().createXml();
+        if (xml == nullptr || !xml->writeTo(file)) {
+            std::cerr << "can't write " << file.getFullPathName() << "\n";
+            return 1;
+        }
+
+        std::cout << "wrote " << file.getFullPathName() << "\n";
+        return 0;
+    }
+
+    bool writeProfile(const juce::File& file, const std::vector<std::unique_ptr<RenderWorker>>& workers) {
+        file.deleteFile();
+        juce::FileOutputStream out(file);
+        if (out.failedToOpen()) {
+            std::cerr << "can't write " << file.getFullPathName() << "\n";
+            return false;
+        }
+
+        for (size_t i{ 0 }; i < workers.size(); ++i) {
+            out << "worker " << juce::String(static_cast<int>(i) + 1) << "\n";
+            workers[i]->writeProfile(out);
+            out << "\n";
+        }
+
+        std::cout << "wrote " << file.getFullPathName() << "\n";
+        return true;
+    }
+
+    int render(const Options& options) {
+        std::atomic<int> nextFile{ 0 };
+        std::vector<std::unique_ptr<RenderWorker>> workers;
+
+        // Processors are built here on the message thread; after that each
+        // one only ever runs on its own worker.
+        for (int i = 0; i < options.numThreads; ++i) {
+            auto processor = std::make_unique<NewProjectAudioProcessor>();
+            if (!applyPreset(*processor, options.preset)) {
+                std::cerr << "the preset isn't a state for this plugin\n";
+                return 1;
+            }
+
+            processor->getProfiler().setOverloadThreshold(options.overloadThreshold);
+            workers.push_back(std::make_unique<RenderWorker>(options, nextFile, std::move(processor)));
+        }
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto& worker : workers)
+            worker->startThread();
+
+        for (auto& worker : workers)
+            worker->waitForThreadToExit(-1);
+
+        const auto wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+        double audioSeconds{ 0 };
+        int numRendered{ 0 }, numFailed{ 0 };
+        for (auto& worker : workers) {
+            audioSeconds += worker->secondsRendered;
+            numRendered += worker->numRendered;
+            numFailed += worker->numFailed;
+        }
+
+        std::cout << numRendered << " files, " << audioSeconds << " s of audio in " << wallSeconds << " s ("
+                  << audioSeconds / juce::jmax(wallSeconds, 1.0e-9) << "x realtime, "
+                  << workers.size() << " threads)";
+        if (numFailed > 0)
+            std::cout << ", " << numFailed << " failed";
+        std::cout << "\n";
+
+        if (options.profileFile != juce::File() && !writeProfile(options.profileFile, workers))
+            return 1;
+
+        return numFailed > 0 ? 1 : 0;
+    }
+}
+
+static int run(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    Options options;
+    options.format = args.getValueForOption("--format").toLowerCase().trimCharactersAtStart(".");
+    options.numThreads = args.containsOption("--threads") ? args.getValueForOption("--threads").getIntValue()
+                                                          : juce::SystemStats::getNumCpus();
+    if (args.containsOption("--chunk"))
+        options.chunkSize = args.getValueForOption("--chunk").getIntValue();
+    if (args.containsOption("--overload"))
+        options.overloadThreshold = args.getValueForOption("--overload").getFloatValue();
+    if (args.containsOption("--profile"))
+        options.profileFile = fileForOption(args, "--profile");
+
+    if (args.containsOption("--preset")) {
+        const auto presetFile = fileForOption(args, "--preset");
+        auto xml = juce::parseXML(presetFile);
+        if (xml == nullptr) {
+            std::cerr << "can't read the preset " << presetFile.getFullPathName() << "\n";
+            return 1;
+        }
+
+        options.preset = juce::ValueTree::fromXml(*xml);
+    }
+
+    if (args.containsOption("--write-preset"))
+        return writePreset(options, fileForOption(args, "--write-preset"));
+
+    options.inputs = findInputs(args);
+
+    if (!args.containsOption("--output") || options.inputs.empty()
+        || options.numThreads < 1 || options.chunkSize < 1 || options.overloadThreshold <= 0.f) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    options.outputDir = fileForOption(args, "--output");
+    if (options.outputDir == juce::File() || !options.outputDir.createDirectory()) {
+        std::cerr << "can't create " << options.outputDir.getFullPathName() << "\n";
+        return 1;
+    }
+
+    if (!assignOutputs(options))
+        return 1;
+
+    options.numThreads = juce::jmin(options.numThreads, static_cast<int>(options.inputs.size()));
+    return render(options);
+}
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    return AllocationCheck::exitCode(run(argc, argv));
+}
@@ -0,0 +1,720 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Headless benchmarks for the compressor engine.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../Common/AllocationCheck.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    constexpr auto usage =
+        "usage: Benchmark [options]\n"
+        "\n"
+        "  --quick             a reduced matrix for a fast check\n"
+        "  --seconds=<s>       audio seconds per case and run, default 2\n"
+        "  --runs=<n>          runs per case, the median is reported, default 5\n"
+        "  --channels=<list>   channel counts to run, e.g. 2,6,12 for stereo, 5.1, 7.1.4\n"
+        "  --sizes=<list>      host block sizes to run, e.g. 2048,4096,8192\n"
+        "  --sub-blocks=<list> the processor's sub-block sizes to compare, 0 for whole\n"
+        "                      host blocks, default 256\n"
+        "  --json=<file>       write the results as JSON\n"
+        "  --label=<text>      stored in the JSON, e.g. the commit hash\n"
+        "  --parallel          compress the bands on worker threads (Parallel Bands)\n"
+        "  --linear-phase      split the bands with the linear phase crossover\n"
+        "  --snapshot          time the parameter snapshot reads instead\n"
+        "  --state             time saving and loading the plugin state instead\n"
+        "  --verify            check the crossover and the compressor curve instead,\n"
+        "                      exiting with 1 if either is out of tolerance\n";
+
+    using Engine = MultiBandCompressor<float, NewProjectAudioProcessor::NumBands>;
+
+   #if JUCE_DEBUG
+    constexpr bool isDebugBuild = true;
+   #else
+    constexpr bool isDebugBuild = false;
+   #endif
+
+    template <typename Fn>
+    double secondsFor(Fn&& fn) {
+        const auto start = juce::Time::getHighResolutionTicks();
+        fn();
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    }
+
+    double median(std::vector<double> values) {
+        jassert(!values.empty());
+        std::sort(values.begin(), values.end());
+        const auto mid = values.size() / 2;
+        return values.size() % 2 != 0 ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+    }
+
+    //==============================================================================
+    // processBlock matrix
+
+    enum class BandState { active, solo, mute, bypass };
+
+    constexpr std::array<BandState, 4> AllStates{ BandState::active, BandState::solo, BandState::mute, BandState::bypass };
+
+    const char* getName(BandState state) {
+        switch (state) {
+        case BandState::active: return "active";
+        case BandState::solo:   return "solo";
+        case BandState::mute:   return "mute";
+        case BandState::bypass: return "bypass";
+        }
+        return "";
+    }
+
+    struct Case {
+        int blockSize;
+        int subBlockSize;
+        double sampleRate;
+        int numChannels;
+        BandState state;
+    };
+
+    // Nanoseconds per sample frame, i.e. per sample of every channel together.
+    struct Result {
+        Case c;
+        double nsPerSample, realtimeFactor;
+        double crossover, compressors, summing, gain;
+    };
+
+    struct Settings {
+        std::vector<int> blockSizes{ 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+        std::vector<double> sampleRates{ 44100.0, 48000.0, 96000.0, 192000.0 };
+        std::vector<int> channelCounts{ 1, 2 };
+        std::vector<int> subBlockSizes{ static_cast<int>(NewProjectAudioProcessor::defaultSubBlockSize) };
+        double secondsPerRun{ 2.0 };
+        int numRuns{ 5 };
+        bool parallelBands{ false };
+        bool linearPhase{ false };
+    };
+
+    void setParameter(juce::AudioProcessorValueTreeState& apvts, const juce::String& id, float value) {
+        auto* param = apvts.getParameter(id);
+        jassert(param != nullptr);
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+    }
+
+    float ratioIndexFor(float ratio) {
+        const auto& choices = Params::RatioChoices;
+        const auto it = std::find(choices.begin(), choices.end(), ratio);
+        jassert(it != choices.end());
+        return static_cast<float>(std::distance(choices.begin(), it));
+    }
+
+    // Every band compresses (4:1 from -24 dB) so the detectors have work to
+    // do; solo and mute leave one band audible, bypass bypasses them all.
+    void applyState(juce::AudioProcessorValueTreeState& apvts, BandState state) {
+        constexpr auto numBands = NewProjectAudioProcessor::NumBands;
+
+        for (size_t band = 0; band < numBands; ++band) {
+            auto id = [band](Params::Names name) { return Params::BandParamID(name, band, numBands); };
+
+            setParameter(apvts, id(Params::Threshold), -24.f);
+            setParameter(apvts, id(Params::Ratio), ratioIndexFor(4.f));
+            setParameter(apvts, id(Params::Bypassed), state == BandState::bypass ? 1.f : 0.f);
+            setParameter(apvts, id(Params::Solo), state == BandState::solo && band == 0 ? 1.f : 0.f);
+            setParameter(apvts, id(Params::Mute), state == BandState::mute && band + 1 < numBands ? 1.f : 0.f);
+        }
+    }
+
+    bool setChannelLayout(juce::AudioProcessor& processor, int numChannels) {
+        const auto set = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(set);
+        layout.inputBuses.add(juce::AudioChannelSet::disabled()); // no sidechain
+        layout.outputBuses.add(set);
+
+        return processor.setBusesLayout(layout);
+    }
+
+    // The same noise for every case and run, loud enough to hit the thresholds.
+    void fillWithNoise(juce::AudioBuffer<float>& buffer) {
+        juce::Random random(0x5eed);
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+            auto* data = buffer.getWritePointer(ch);
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                data[i] = 0.5f * (2.f * random.nextFloat() - 1.f);
+        }
+    }
+
+    // Times whole processBlock calls, then the stages one by one through a
+    // separate engine built the way the processor builds its own. The stages
+    // always run on whole host blocks, whatever the case's sub-block size.
+    // Blocks are processed in place along one long buffer, so no copying is
+    // timed.
+    Result runCase(const Case& c, const Settings& settings) {
+        NewProjectAudioProcessor processor;
+        const auto ok = setChannelLayout(processor, c.numChannels);
+        jassert(ok);
+        juce::ignoreUnused(ok);
+        applyState(processor.apvts, c.state);
+        setParameter(processor.apvts, Params::ParallelBands, settings.parallelBands ? 1.f : 0.f);
+        setParameter(processor.apvts, Params::CrossoverMode, settings.linearPhase ? 1.f : 0.f);
+        processor.setSubBlockSize(static_cast<size_t>(c.subBlockSize));
+
+        const auto numBlocks = juce::jmax(1, static_cast<int>(settings.secondsPerRun * c.sampleRate) / c.blockSize);
+        const auto numSamples = numBlocks * c.blockSize;
+        const auto audioSeconds = numSamples / c.sampleRate;
+
+        juce::AudioBuffer<float> audio(c.numChannels, numSamples);
+        juce::MidiBuffer midi;
+
+        auto forEachBlock = [&](auto&& fn) {
+            for (int start = 0; start < numSamples; start += c.blockSize)
+                fn(start);
+        };
+
+        std::vector<double> totals;
+        for (int run = 0; run < settings.numRuns; ++run) {
+            fillWithNoise(audio);
+            processor.prepareToPlay(c.sampleRate, c.blockSize);
+
+            totals.push_back(secondsFor([&] {
+                forEachBlock([&](int start) {
+                    juce::AudioBuffer<float> block(audio.getArrayOfWritePointers(), c.numChannels, start, c.blockSize);
+                    processor.processBlock(block, midi);
+                });
+            }));
+
+            processor.releaseResources();
+        }
+
+        juce::dsp::ProcessSpec spec{ c.sampleRate, static_cast<juce::uint32>(c.blockSize), static_cast<juce::uint32>(c.numChannels) };
+        Engine engine;
+        engine.attach(processor.apvts);
+        engine.setChannelGroups(ChannelGroups::forLayout(juce::AudioChannelSet::canonicalChannelSet(c.numChannels)));
+        juce::dsp::Gain<float> inGain, outGain;
+
+        std::vector<double> crossover, compressors, summing, gain;
+        for (int run = 0; run < settings.numRuns; ++run) {
+            fillWithNoise(audio);
+            engine.prepare(spec);
+            inGain.prepare(spec);
+            outGain.prepare(spec);
+
+            juce::int64 ticks[4]{};
+            forEachBlock([&](int start) {
+                auto block = juce::dsp::AudioBlock<float>(audio).getSubBlock(static_cast<size_t>(start), static_cast<size_t>(c.blockSize));
+                auto context = juce::dsp::ProcessContextReplacing<float>(block);
+                engine.update();
+
+                const auto t0 = juce::Time::getHighResolutionTicks();
+                inGain.process(context);
+                const auto t1 = juce::Time::getHighResolutionTicks();
+                engine.splitBands(block);
+                const auto t2 = juce::Time::getHighResolutionTicks();
+                engine.compressBands();
+                const auto t3 = juce::Time::getHighResolutionTicks();
+                engine.sumBands(block);
+                const auto t4 = juce::Time::getHighResolutionTicks();
+                outGain.process(context);
+                const auto t5 = juce::Time::getHighResolutionTicks();
+
+                ticks[0] += t2 - t1;
+                ticks[1] += t3 - t2;
+                ticks[2] += t4 - t3;
+                ticks[3] += (t1 - t0) + (t5 - t4);
+            });
+
+            crossover.push_back(juce::Time::highResolutionTicksToSeconds(ticks[0]));
+            compressors.push_back(juce::Time::highResolutionTicksToSeconds(ticks[1]));
+            summing.push_back(juce::Time::highResolutionTicksToSeconds(ticks[2]));
+            gain.push_back(juce::Time::highResolutionTicksToSeconds(ticks[3]));
+        }
+
+        auto nsPerSample = [numSamples](double seconds) { return seconds * 1.0e9 / numSamples; };
+        const auto total = median(totals);
+
+        return { c, nsPerSample(total), audioSeconds / juce::jmax(total, 1.0e-12),
+                 nsPerSample(median(crossover)), nsPerSample(median(compressors)),
+                 nsPerSample(median(summing)), nsPerSample(median(gain)) };
+    }
+
+    void printRow(const Result& r) {
+        auto fixed = [](double value, int decimals) { return juce::String(value, decimals).toStdString(); };
+
+        std::cout << std::setw(6) << r.c.blockSize << std::setw(6) << r.c.subBlockSize << std::setw(8) << juce::roundToInt(r.c.sampleRate)
+                  << std::setw(4) << r.c.numChannels << std::setw(8) << getName(r.c.state)
+                  << std::setw(10) << fixed(r.nsPerSample, 2) << std::setw(10) << fixed(r.realtimeFactor, 1)
+                  << std::setw(11) << fixed(r.crossover, 2) << std::setw(12) << fixed(r.compressors, 2)
+                  << std::setw(9) << fixed(r.summing, 2) << std::setw(8) << fixed(r.gain, 2) << "\n";
+    }
+
+    juce::var toJson(const std::vector<Result>& results, const Settings& settings, const juce::String& label) {
+        juce::Array<juce::var> rows;
+
+        for (auto& r : results) {
+            juce::DynamicObject::Ptr stages = new juce::DynamicObject();
+            stages->setProperty("crossover", r.crossover);
+            stages->setProperty("compressors", r.compressors);
+            stages->setProperty("summing", r.summing);
+            stages->setProperty("gain", r.gain);
+
+            juce::DynamicObject::Ptr row = new juce::DynamicObject();
+            row->setProperty("blockSize", r.c.blockSize);
+            row->setProperty("subBlockSize", r.c.subBlockSize);
+            row->setProperty("sampleRate", r.c.sampleRate);
+            row->setProperty("channels", r.c.numChannels);
+            row->setProperty("state", getName(r.c.state));
+            row->setProperty("nsPerSample", r.nsPerSample);
+            row->setProperty("realtimeFactor", r.realtimeFactor);
+            row->setProperty("stageNsPerSample", stages.get());
+            rows.add(row.get());
+        }
+
+        juce::DynamicObject::Ptr root = new juce::DynamicObject();
+        root->setProperty("label", label);
+        root->setProperty("bands", static_cast<int>(NewProjectAudioProcessor::NumBands));
+        root->setProperty("cpu", juce::SystemStats::getCpuModel());
+        root->setProperty("juce", juce::SystemStats::getJUCEVersion());
+        root->setProperty("debugBuild", isDebugBuild);
+        root->setProperty("secondsPerRun", settings.secondsPerRun);
+        root->setProperty("runs", settings.numRuns);
+        root->setProperty("parallelBands", settings.parallelBands);
+        root->setProperty("linearPhase", settings.linearPhase);
+        root->setProperty("results", rows);
+        return root.get();
+    }
+
+    int runProcessBlockBenchmark(const Settings& settings, const juce::File& jsonFile, const juce::String& label) {
+        std::cout << "processBlock, " << NewProjectAudioProcessor::NumBands << " bands, ns per sample frame"
+                  << " (median of " << settings.numRuns << " runs)\n"
+                  << " block   sub    rate  ch   state   ns/smp  realtime  crossover compressors  summing    gain\n";
+
+        std::vector<Result> results;
+        for (auto sampleRate : settings.sampleRates)
+            for (auto numChannels : settings.channelCounts)
+                for (auto blockSize : settings.blockSizes)
+                    for (auto subBlockSize : settings.subBlockSizes)
+                        for (auto state : AllStates)
+                            printRow(results.emplace_back(runCase({ blockSize, subBlockSize, sampleRate, numChannels, state }, settings)));
+
+        if (jsonFile != juce::File()) {
+            if (!jsonFile.replaceWithText(juce::JSON::toString(toJson(results, settings, label)))) {
+                std::cerr << "can't write " << jsonFile.getFullPathName() << "\n";
+                return 1;
+            }
+
+            std::cout << "wrote " << jsonFile.getFullPathName() << "\n";
+        }
+
+        return 0;
+    }
+
+    //==============================================================================
+    // parameter snapshot reads
+
+    struct Snapshot {
+        float attack, release, threshold, ratio;
+        bool bypassed, mute, solo;
+    };
+
+    // The per-block reads CompressorBand used to do: through the parameter
+    // objects, with the ratio parsed back out of the choice name.
+    struct LegacyBand {
+        juce::AudioParameterFloat* attack{ nullptr };
+        juce::AudioParameterFloat* release{ nullptr };
+        juce::AudioParameterFloat* threshold{ nullptr };
+        juce::AudioParameterChoice* ratio{ nullptr };
+        juce::AudioParameterBool* bypassed{ nullptr };
+        juce::AudioParameterBool* mute{ nullptr };
+        juce::AudioParameterBool* solo{ nullptr };
+
+        LegacyBand(juce::AudioProcessorValueTreeState& apvts, size_t band, size_t numBands) {
+            auto get = [&](auto& param, Params::Names name) {
+                param = dynamic_cast<std::remove_reference_t<decltype(*param)>*>(apvts.getParameter(Params::BandParamID(name, band, numBands)));
+                jassert(param != nullptr);
+            };
+
+            get(attack, Params::Attack);
+            get(release, Params::Release);
+            get(threshold, Params::Threshold);
+            get(ratio, Params::Ratio);
+            get(bypassed, Params::Bypassed);
+            get(mute, Params::Mute);
+            get(solo, Params::Solo);
+        }
+
+        Snapshot read() const {
+            return { attack->get(), release->get(), threshold->get(),
+                     ratio->getCurrentChoiceName().getFloatValue(),
+                     bypassed->get(), mute->get(), solo->get() };
+        }
+    };
+
+    Snapshot readCached(const CompressorBand<float>& band) {
+        return { band.Attack->load(), band.Release->load(), band.Threshold->load(),
+                 Params::RatioFromIndex(band.Ratio->load()),
+                 band.IsBypassed(), band.IsMuted(), band.IsSoloed() };
+    }
+
+    // Reads every band's settings once per simulated block, across a number
+    // of processor instances, the old way and from the cached raw values.
+    void runParameterSnapshotBenchmark(int numInstances, int numBlocks) {
+        std::vector<std::unique_ptr<NewProjectAudioProcessor>> processors;
+        std::vector<LegacyBand> legacyBands;
+        constexpr auto numBands = NewProjectAudioProcessor::NumBands;
+        std::vector<CompressorBand<float>> cachedBands(static_cast<size_t>(numInstances) * numBands);
+
+        for (int i = 0; i < numInstances; ++i) {
+            auto& processor = *processors.emplace_back(std::make_unique<NewProjectAudioProcessor>());
+
+            for (size_t band = 0; band < numBands; ++band) {
+                legacyBands.emplace_back(processor.apvts, band, numBands);
+                cachedBands[static_cast<size_t>(i) * numBands + band].Attach(processor.apvts, band, numBands);
+            }
+        }
+
+        auto sink = 0.f;
+        auto accumulate = [&sink](const Snapshot& s) {
+            sink += s.attack + s.release + s.threshold + s.ratio
+                  + (s.bypassed ? 1.f : 0.f) + (s.mute ? 1.f : 0.f) + (s.solo ? 1.f : 0.f);
+        };
+
+        const auto legacySeconds = secondsFor([&] {
+            for (int block = 0; block < numBlocks; ++block)
+                for (auto& band : legacyBands)
+                    accumulate(band.read());
+        });
+
+        const auto cachedSeconds = secondsFor([&] {
+            for (int block = 0; block < numBlocks; ++block)
+                for (auto& band : cachedBands)
+                    accumulate(readCached(band));
+        });
+
+        const auto numReads = static_cast<double>(numBlocks) * static_cast<double>(legacyBands.size());
+
+        std::cout << "parameter snapshot, " << numInstances << " instances x "
+                  << numBands << " bands, " << numBlocks << " blocks\n"
+                  << "  string parse: " << legacySeconds * 1.0e9 / numReads << " ns/band\n"
+                  << "  cached table: " << cachedSeconds * 1.0e9 / numReads << " ns/band\n"
+                  << "  speedup:      " << legacySeconds / juce::jmax(cachedSeconds, 1.0e-12) << "x"
+                  << "  (" << sink << ")\n";
+    }
+
+    //==============================================================================
+    // state save and load
+
+    // Saves and loads every instance's state numRounds times, the old way (the
+    // APVTS ValueTree) and through the binary ParameterState blob.
+    void runStateBenchmark(int numInstances, int numRounds) {
+        std::vector<std::unique_ptr<NewProjectAudioProcessor>> processors;
+        juce::Random random(1);
+
+        for (int i = 0; i < numInstances; ++i) {
+            auto& processor = *processors.emplace_back(std::make_unique<NewProjectAudioProcessor>());
+
+            // something other than the defaults to write out
+            for (auto* parameter : processor.getParameters())
+                parameter->setValueNotifyingHost(random.nextFloat());
+        }
+
+        std::vector<juce::MemoryBlock> legacyStates(processors.size()), binaryStates(processors.size());
+
+        const auto legacySaveSeconds = secondsFor([&] {
+            for (int round = 0; round < numRounds; ++round) {
+                for (size_t i = 0; i < processors.size(); ++i) {
+                    legacyStates[i].reset();
+                    juce::MemoryOutputStream stream(legacyStates[i], true);
+                    processors[i]->apvts.state.writeToStream(stream);
+                }
+            }
+        });
+
+        const auto legacyLoadSeconds = secondsFor([&] {
+            for (int round = 0; round < numRounds; ++round) {
+                for (size_t i = 0; i < processors.size(); ++i) {
+                    auto tree = juce::ValueTree::readFromData(legacyStates[i].getData(), legacyStates[i].getSize());
+                    if (tree.isValid())
+                        processors[i]->apvts.replaceState(tree);
+                }
+            }
+        });
+
+        const auto binarySaveSeconds = secondsFor([&] {
+            for (int round = 0; round < numRounds; ++round)
+                for (size_t i = 0; i < processors.size(); ++i)
+                    processors[i]->getStateInformation(binaryStates[i]);
+        });
+
+        const auto binaryLoadSeconds = secondsFor([&] {
+            for (int round = 0; round < numRounds; ++round)
+                for (size_t i = 0; i < processors.size(); ++i)
+                    processors[i]->setStateInformation(binaryStates[i].getData(), static_cast<int>(binaryStates[i].getSize()));
+        });
+
+        const auto numOperations = static_cast<double>(numRounds) * static_cast<double>(numInstances);
+        auto microseconds = [numOperations](double seconds) { return juce::String(seconds * 1.0e6 / numOperations, 2).toStdString(); };
+
+        std::cout << "state, " << numInstances << " instances x " << numRounds << " rounds\n"
+                  << "              save us   load us   bytes\n"
+                  << "  ValueTree " << std::setw(9) << microseconds(legacySaveSeconds) << std::setw(10) << microseconds(legacyLoadSeconds)
+                  << std::setw(8) << legacyStates[0].getSize() << "\n"
+                  << "  binary    " << std::setw(9) << microseconds(binarySaveSeconds) << std::setw(10) << microseconds(binaryLoadSeconds)
+                  << std::setw(8) << binaryStates[0].getSize() << "\n";
+    }
+
+    //==============================================================================
+    // verification
+
+    // The crossover may differ from the filters it replaced by float rounding
+    // only, and the compressor settles on its static curve to within the
+    // error of FastMath's log2 and exp2.
+    constexpr double maxCrossoverError = 5.0e-7;
+    constexpr double maxCurveErrorDb = 0.02;
+
+    // The largest difference between the crossover and the tree of
+    // LinkwitzRileyFilters it replaced, over a second of noise. The tree is
+    // the three band one spread to any band count: each split's lowpass is a
+    // band and its highpass goes on to the next split, then every band runs
+    // through the allpass of each split above it. For three bands those are
+    // the old LP1, AP2, HP1, LP2 and HP2.
+    double measureCrossoverError(double sampleRate, int numChannels, int blockSize) {
+        constexpr auto numBands = NewProjectAudioProcessor::NumBands;
+        using Crossover = LinkwitzRileyCrossover<float, numBands>;
+        using Filter = juce::dsp::LinkwitzRileyFilter<float>;
+        using FilterType = juce::dsp::LinkwitzRileyFilterType;
+
+        const juce::dsp::ProcessSpec spec{ sampleRate, static_cast<juce::uint32>(blockSize), static_cast<juce::uint32>(numChannels) };
+
+        auto makeFilter = [&spec](FilterType type, float frequency) {
+            Filter filter;
+            filter.setType(type);
+            filter.setCutoffFrequency(frequency);
+            filter.prepare(spec);
+            return filter;
+        };
+
+        Crossover crossover;
+        std::vector<Filter> lowpass, highpass;
+        std::array<std::vector<Filter>, numBands> allpass;
+
+        // spread on a log scale between 100 Hz and 8 kHz
+        for (size_t split = 0; split < Crossover::numSplits; ++split) {
+            const auto frequency = 100.f * std::pow(80.f, static_cast<float>(split + 1) / static_cast<float>(numBands));
+            crossover.setCrossoverFrequency(split, frequency);
+            lowpass.push_back(makeFilter(FilterType::lowpass, frequency));
+            highpass.push_back(makeFilter(FilterType::highpass, frequency));
+
+            for (size_t band = 0; band < split; ++band)
+                allpass[band].push_back(makeFilter(FilterType::allpass, frequency));
+        }
+
+        crossover.prepare(spec);
+
+        juce::AudioBuffer<float> input(numChannels, blockSize);
+        std::array<juce::AudioBuffer<float>, numBands> bands;
+        typename Crossover::BandBlocks bandBlocks;
+        for (size_t band = 0; band < numBands; ++band) {
+            bands[band].setSize(numChannels, blockSize);
+            bandBlocks[band] = juce::dsp::AudioBlock<float>(bands[band]);
+        }
+
+        double maxError = 0;
+        for (int start = 0; start < static_cast<int>(sampleRate); start += blockSize) {
+            fillWithNoise(input);
+            crossover.process(juce::dsp::AudioBlock<float>(input), bandBlocks);
+
+            for (int ch = 0; ch < numChannels; ++ch) {
+                for (int i = 0; i < blockSize; ++i) {
+                    auto remainder = input.getSample(ch, i);
+
+                    for (size_t band = 0; band < numBands; ++band) {
+                        auto expected = remainder;
+                        if (band < Crossover::numSplits) {
+                            expected = lowpass[band].processSample(ch, remainder);
+                            remainder = highpass[band].processSample(ch, remainder);
+                        }
+
+                        for (auto& filter : allpass[band])
+                            expected = filter.processSample(ch, expected);
+
+                        maxError = std::max(maxError, static_cast<double>(std::abs(expected - bands[band].getSample(ch, i))));
+                    }
+                }
+            }
+        }
+
+        return maxError;
+    }
+
+    // The gain in dB the compressor should settle on for a steady level,
+    // worked out in double: none below the knee, the ratio's slope above it,
+    // and a quadratic between the two.
+    double expectedGainDb(double levelDb, double thresholdDb, double ratio, double kneeDb) {
+        const auto over = levelDb - thresholdDb;
+        const auto slope = 1.0 / ratio - 1.0;
+
+        if (2.0 * over <= -kneeDb)
+            return 0.0;
+        if (2.0 * over >= kneeDb)
+            return slope * over;
+
+        const auto intoKnee = over + 0.5 * kneeDb;
+        return slope * intoKnee * intoKnee / (2.0 * kneeDb);
+    }
+
+    // Holds the compressor on a constant level until the attack and release
+    // have settled, and returns how far the gain it applies is off the curve.
+    double measureCurveError(float levelDb, float thresholdDb, float ratio, float kneeDb) {
+        constexpr double sampleRate = 48000.0;
+        constexpr int blockSize = 512;
+
+        CompressorKernel<float> kernel;
+        kernel.prepare({ sampleRate, static_cast<juce::uint32>(blockSize), 1 });
+        kernel.setThreshold(thresholdDb);
+        kernel.setRatio(ratio);
+        kernel.setKnee(kneeDb);
+        kernel.setAttack(5.f);
+        kernel.setRelease(50.f);
+
+        const auto level = juce::Decibels::decibelsToGain(levelDb);
+        juce::AudioBuffer<float> block(1, blockSize);
+
+        for (int start = 0; start < static_cast<int>(sampleRate); start += blockSize) {
+            juce::FloatVectorOperations::fill(block.getWritePointer(0), level, blockSize);
+            kernel.process(juce::dsp::AudioBlock<float>(block));
+        }
+
+        const auto gainDb = juce::Decibels::gainToDecibels(static_cast<double>(block.getSample(0, blockSize - 1)) / level);
+        return std::abs(gainDb - expectedGainDb(levelDb, thresholdDb, ratio, kneeDb));
+    }
+
+    // Checks the crossover against the filters it replaced and the
+    // compressor against its static curve, printing every case. Returns
+    // false if any of them is out of tolerance.
+    bool runVerification() {
+        auto passed = true;
+
+        auto report = [&passed](double error, double tolerance) {
+            passed = passed && error < tolerance;
+            return error < tolerance ? "ok" : "FAILED";
+        };
+
+        std::cout << "crossover against the LinkwitzRileyFilter tree, " << NewProjectAudioProcessor::NumBands
+                  << " bands, max error (< " << maxCrossoverError << ")\n";
+
+        for (auto sampleRate : { 44100.0, 96000.0 }) {
+            for (auto numChannels : { 1, 2, 6, 16 }) {
+                const auto error = measureCrossoverError(sampleRate, numChannels, 480);
+                std::cout << std::setw(8) << juce::roundToInt(sampleRate) << std::setw(4) << numChannels
+                          << std::setw(14) << error << "  " << report(error, maxCrossoverError) << "\n";
+            }
+        }
+
+        std::cout << "compressor static curve, max error in dB (< " << maxCurveErrorDb << ")\n";
+
+        for (auto thresholdDb : { -24.f, -6.f }) {
+            for (auto ratio : { 2.f, 4.f, 100.f }) {
+                for (auto kneeDb : { 0.f, 6.f, 12.f }) {
+                    double error = 0;
+                    for (auto levelDb = -48.f; levelDb <= 0.f; levelDb += 1.5f)
+                        error = std::max(error, measureCurveError(levelDb, thresholdDb, ratio, kneeDb));
+
+                    std::cout << std::setw(6) << thresholdDb << " dB" << std::setw(6) << ratio << ":1"
+                              << std::setw(6) << kneeDb << " dB knee" << std::setw(12) << error << "  "
+                              << report(error, maxCurveErrorDb) << "\n";
+                }
+            }
+        }
+
+        std::cout << (passed ? "all checks passed\n" : "some checks FAILED\n");
+        return passed;
+    }
+}
+
+static int run(int argc, char* argv[]) {
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h")) {
+        std::cout << usage;
+        return 0;
+    }
+
+    if (args.containsOption("--verify"))
+        return runVerification() ? 0 : 1;
+
+    if (args.containsOption("--snapshot")) {
+        const auto numBlocks = args.containsOption("--blocks") ? args.getValueForOption("--blocks").getIntValue() : 10000;
+
+        for (auto numInstances : { 1, 16, 128 })
+            runParameterSnapshotBenchmark(numInstances, numBlocks);
+
+        return 0;
+    }
+
+    if (args.containsOption("--state")) {
+        const auto numRounds = args.containsOption("--rounds") ? args.getValueForOption("--rounds").getIntValue() : 20;
+
+        for (auto numInstances : { 1, 16, 128 })
+            runStateBenchmark(numInstances, numRounds);
+
+        return 0;
+    }
+
+    Settings settings;
+    if (args.containsOption("--quick")) {
+        settings.blockSizes = { 64, 512, 4096 };
+        settings.sampleRates = { 48000.0 };
+        settings.channelCounts = { 2 };
+    }
+
+    if (args.containsOption("--seconds"))
+        settings.secondsPerRun = args.getValueForOption("--seconds").getDoubleValue();
+    if (args.containsOption("--runs"))
+        settings.numRuns = args.getValueForOption("--runs").getIntValue();
+    const auto intList = [&args](juce::StringRef option) {
+        std::vector<int> values;
+        for (auto& value : juce::StringArray::fromTokens(args.getValueForOption(option), ",", ""))
+            values.push_back(value.getIntValue());
+        return values;
+    };
+
+    if (args.containsOption("--channels"))
+        settings.channelCounts = intList("--channels");
+    if (args.containsOption("--sizes"))
+        settings.blockSizes = intList("--sizes");
+    if (args.containsOption("--sub-blocks"))
+        settings.subBlockSizes = intList("--sub-blocks");
+    settings.parallelBands = args.containsOption("--parallel");
+    settings.linearPhase = args.containsOption("--linear-phase");
+
+    const auto isValidChannelCount = [](int count) {
+        return count >= 1 && static_cast<size_t>(count) <= Engine::maxChannels;
+    };
+
+    const auto isPositive = [](int size) { return size > 0; };
+    const auto isNotNegative = [](int size) { return size >= 0; };
+
+    if (settings.secondsPerRun <= 0 || settings.numRuns < 1 || settings.channelCounts.empty()
+        || settings.blockSizes.empty() || settings.subBlockSizes.empty()
+        || !std::all_of(settings.channelCounts.begin(), settings.channelCounts.end(), isValidChannelCount)
+        || !std::all_of(settings.blockSizes.begin(), settings.blockSizes.end(), isPositive)
+        || !std::all_of(settings.subBlockSizes.begin(), settings.subBlockSizes.end(), isNotNegative)) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    const auto jsonValue = args.getValueForOption("--json").unquoted();
+    const auto jsonFile = jsonValue.isEmpty() ? juce::File() : juce::File::getCurrentWorkingDirectory().getChildFile(jsonValue);
+
+    return runProcessBlockBenchmark(settings, jsonFile, args.getValueForOption("--label"));
+}
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    return AllocationCheck::exitCode(run(argc, argv));
+}
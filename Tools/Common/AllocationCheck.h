@@ -0,0 +1,28 @@
+/*
+  ==============================================================================
+
+    AllocationCheck.h
+    Turns the allocation guard's count into the tools' exit code.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../../Source/DSP/AllocationGuard.h"
+
+#include <iostream>
+
+namespace AllocationCheck {
+    // The Debug configurations build with MBC_ALLOCATION_GUARD, so a Debug
+    // run of a tool doubles as the check that processBlock never touches the
+    // heap: any allocation it made fails the run, whatever it returned.
+    inline int exitCode(int result) {
+        const auto numViolations = AllocationGuard::getNumViolations();
+        if (numViolations == 0)
+            return result;
+
+        std::cerr << numViolations << " heap allocations inside processBlock\n";
+        return result != 0 ? result : 3;
+    }
+}
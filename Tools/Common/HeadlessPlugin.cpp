@@ -0,0 +1,22 @@
+/*
+  ==============================================================================
+
+    HeadlessPlugin.cpp
+    Compiles the plugin's sources into the command line tools.
+
+  ==============================================================================
+*/
+
+// The tools are plain console apps, so nothing defines the plugin macros.
+#ifndef JucePlugin_Name
+ #define JucePlugin_Name "ThreeBandCompressor"
+#endif
+
+// Renders and benchmarks leave the user's preset bank alone.
+#ifndef MBC_USER_PRESETS
+ #define MBC_USER_PRESETS 0
+#endif
+
+#include "../../Source/PluginProcessor.cpp"
+#include "../../Source/PluginEditor.cpp"
+#include "../../Source/DSP/AllocationGuard.cpp"